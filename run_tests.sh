@@ -24,9 +24,9 @@ function error() {
 trap error ERR
 
 # Test names
-TESTS=(json server)
+TESTS=(json server arena scan)
 # Integration tests
-I_TESTS=(staticfiles simpleapi)
+I_TESTS=(staticfiles simpleapi simpleapi_loop)
 
 # Compile the library to make sure the changes are applied
 mkdir -p build
@@ -39,7 +39,7 @@ cd ..
 OBJECTS=build/libcrestapi.a
 
 CC=gcc
-TEST_CFLAGS="-std=c99 -pthread -Wall -Wextra -Werror -Wno-unused-parameter -Wno-unused-function -lcheck -lsubunit -lrt -lm"
+TEST_CFLAGS="-std=c99 -pthread -Wall -Wextra -Werror -Wno-unused-parameter -Wno-unused-function -lcheck -lsubunit -lrt -lm -lz"
 
 if [[ $RUN == "unit" || $RUN == "all" ]]
 then
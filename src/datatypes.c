@@ -4,26 +4,54 @@
 #include "utils/hashtable.h"
 #include "utils/memory.h"
 
-static String* allocate_string(char* chars, int length, uint32_t hash)
+String* copy_chars(const char* chars, int length)
 {
-    String* string = ALLOCATE(String, 1);
+    String* string = POOL_ALLOCATE(String);
     string->len = length;
-    string->chars = chars;
-    string->hash = hash;
+    string->hash = hash_string(chars, length);
+    if (length < STRING_INLINE_CAPACITY) {
+        // Zeroed like the chars STRING_APPEND grows
+        memset(string->small, 0, STRING_INLINE_CAPACITY);
+        string->chars = string->small;
+        string->capacity = STRING_INLINE_CAPACITY;
+    } else {
+        string->chars = ALLOCATE(char, length + 1);
+        string->capacity = length + 1;
+    }
+    memcpy(string->chars, chars, length);
+    string->chars[length] = '\0';
 
     return string;
 }
 
-String* copy_chars(const char* chars, int length)
+void string_grow(String* str, int capacity)
 {
-    uint32_t hash = hash_string(chars, length);
-
-    char* tmp_chars = ALLOCATE(char, length + 1);
-    memcpy(tmp_chars, chars, length);
-    tmp_chars[length] = '\0';
+    int old_capacity = str->capacity;
+    if (STRING_IS_INLINE(str)) {
+        // The inline chars move to the heap
+        str->chars = ALLOCATE(char, capacity);
+        memcpy(str->chars, str->small, old_capacity);
+    } else {
+        str->chars = GROW_ARRAY(str->chars, char, old_capacity, capacity);
+    }
+    memset(str->chars + old_capacity, 0, capacity - old_capacity);
+    str->capacity = capacity;
+}
 
-    return allocate_string(tmp_chars, length, hash);
+void string_append_chars(String* str, const char* chars, int length)
+{
+    if (str->capacity < str->len + length + 1) {
+        int capacity = GROW_CAPACITY(str->capacity);
+        while (capacity < str->len + length + 1)
+            capacity *= 2;
+        string_grow(str, capacity);
+    }
+    memcpy(str->chars + str->len, chars, length);
+    str->len += length;
+    // Keep the chars null terminated like STRING_APPEND does
+    str->chars[str->len] = '\0';
 }
+
 String* copy_string(const String* str)
 {
     return copy_chars(str->chars, str->len);
@@ -43,10 +71,32 @@ void copy_data_value(DataValue* value)
         value->data = (void*)copy_table((Table*)value->data);
         break;
 
+    case TYPE_NUMBER:
+        *value = number_value(*(float*)value->data);
+        break;
+
+    case TYPE_BOOL:
+        *value = bool_value(*(bool*)value->data);
+        break;
+
     default:
         break;
     }
 }
+DataValue bool_value(bool value)
+{
+    bool* cell = POOL_ALLOCATE(bool);
+    *cell = value;
+    return (DataValue){ TYPE_BOOL, cell };
+}
+
+DataValue number_value(float value)
+{
+    float* cell = POOL_ALLOCATE(float);
+    *cell = value;
+    return (DataValue){ TYPE_NUMBER, cell };
+}
+
 void init_array(Array* arr)
 {
     arr->values = NULL;
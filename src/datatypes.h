@@ -2,6 +2,7 @@
 #define REST_DATATYPES_H_
 
 #include "utils/memory.h"
+#include "utils/pool.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -33,9 +34,11 @@ typedef struct {
 #define AS_STRING(value) ((String*)(value).data)
 #define AS_CSTRING(value) (((String*)(value).data)->chars)
 
-#define BOOL_VAL(value) ((DataValue){ TYPE_BOOL, (void*)value })
+// Number and bool values own a cell from the pool, freed with the
+// JSON object or array holding them
+#define BOOL_VAL(value) bool_value(value)
 #define NULL_VAL ((DataValue){ TYPE_NULL, NULL })
-#define NUMBER_VAL(value) ((DataValue){ TYPE_NUMBER, &(float){ strtof(value, NULL) } })
+#define NUMBER_VAL(value) number_value(strtof(value, NULL))
 
 typedef struct
 {
@@ -52,13 +55,28 @@ typedef struct
     float value;
 } Number;
 
+// Room for the chars and the null of short strings inside String
+#define STRING_INLINE_CAPACITY 20
+
 typedef struct {
     char* chars;
     int len;
     int capacity;
     uint32_t hash; // for table reference
+    // Strings from copy_chars shorter than STRING_INLINE_CAPACITY keep
+    // their chars here so the String and its chars are one allocation.
+    // A String copied by value still points to the chars of the original
+    char small[STRING_INLINE_CAPACITY];
 } String;
 
+#define STRING_IS_INLINE(str) ((str)->chars == (str)->small)
+
+// Characters owned by someone else, not null terminated
+typedef struct {
+    const char* chars;
+    int len;
+} StringSlice;
+
 typedef struct
 {
     DataValue* values;
@@ -66,18 +84,12 @@ typedef struct
     int capacity;
 } Array;
 
-#define STRING_APPEND(str, c)                                                              \
-    do {                                                                                   \
-        if ((str)->capacity < (str)->len + 1) {                                            \
-            int _old_capacity = (str)->capacity;                                           \
-            (str)->capacity = GROW_CAPACITY(_old_capacity);                                \
-            (str)->chars = GROW_ARRAY((str)->chars, char, _old_capacity, (str)->capacity); \
-            for (int _i = _old_capacity; _i < (str)->capacity; _i++) {                     \
-                (str)->chars[_i] = '\0';                                                   \
-            }                                                                              \
-        }                                                                                  \
-        (str)->chars[(str)->len] = c;                                                      \
-        (str)->len++;                                                                      \
+#define STRING_APPEND(str, c)                                   \
+    do {                                                        \
+        if ((str)->capacity < (str)->len + 1)                   \
+            string_grow((str), GROW_CAPACITY((str)->capacity)); \
+        (str)->chars[(str)->len] = c;                           \
+        (str)->len++;                                           \
     } while (0);
 
 #define STRING_APPEND_STRING(str1, str2)        \
@@ -91,11 +103,17 @@ typedef struct
     };
 
 // Free the char pointer
-#define STRING_FREE(str) FREE(char, (str)->chars)
+#define STRING_FREE(str)                \
+    do {                                \
+        if (!STRING_IS_INLINE(str))     \
+            FREE(char, (str)->chars);   \
+    } while (0)
 // Free the char pointer and the String pointer
-#define STRINGP_FREE(str)     \
-    FREE(char, (str)->chars); \
-    FREE(String, (str))
+#define STRINGP_FREE(str)         \
+    do {                          \
+        STRING_FREE(str);         \
+        POOL_FREE(String, (str)); \
+    } while (0)
 
 #define STRING_INIT(str) \
     (str)->chars = NULL; \
@@ -104,8 +122,14 @@ typedef struct
     (str)->hash = 0;
 
 String* copy_chars(const char* chars, int length);
+// Grow the chars to capacity, the new chars are zeroed
+void string_grow(String* str, int capacity);
+// Append length chars to str with a single copy
+void string_append_chars(String* str, const char* chars, int length);
 String* copy_string(const String* str);
 void copy_data_value(DataValue* value);
+DataValue bool_value(bool value);
+DataValue number_value(float value);
 void init_array(Array* arr);
 
 #endif
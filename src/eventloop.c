@@ -0,0 +1,400 @@
+/**
+ * <sys/epoll.h>
+ *
+ * defines:
+ * EPOLLIN, EPOLLOUT, EPOLLET, EPOLLRDHUP, EPOLLEXCLUSIVE
+ *
+ * functions:
+ * epoll_create1(), epoll_ctl(), epoll_wait()
+ */
+#include <sys/epoll.h>
+
+/**
+ * <sys/socket.h>
+ *
+ * functions:
+ * accept(), recv()
+ */
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "eventloop.h"
+#include "http.h"
+#include "options.h"
+#include "requests/request.h"
+#include "utils/memory.h"
+
+#define EVENT_LOOP_MAX_EVENTS 64
+// How often idle clients are checked in milliseconds
+#define EVENT_LOOP_TICK_MS 1000
+// Most bytes read from a client before handling them
+#define EVENT_LOOP_READ_LIMIT (256 * 1024)
+
+typedef enum {
+    // Waiting for the rest of the request
+    CLIENT_READING,
+    // Received data is waiting to be handled
+    CLIENT_HANDLING,
+    // Responses wait for the socket to be writable, nothing is read
+    CLIENT_WRITING,
+    // Client should be closed and freed
+    CLIENT_CLOSING
+} ClientState;
+
+typedef struct LoopClient {
+    Connection conn;
+    ClientState state;
+    // Close once the pending responses are sent
+    bool close_when_sent;
+    // Time of the last received data or sent pending output
+    time_t last_active;
+    // Clients of the loop ordered by last_active, oldest first
+    struct LoopClient* prev;
+    struct LoopClient* next;
+} LoopClient;
+
+typedef struct {
+    pthread_t thread;
+    int epollfd;
+    int socketfd;
+    LoopClient* oldest;
+    LoopClient* newest;
+} EventLoop;
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1)
+        return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void unlink_client(EventLoop* loop, LoopClient* client)
+{
+    if (client->prev != NULL)
+        client->prev->next = client->next;
+    else if (loop->oldest == client)
+        loop->oldest = client->next;
+
+    if (client->next != NULL)
+        client->next->prev = client->prev;
+    else if (loop->newest == client)
+        loop->newest = client->prev;
+
+    client->prev = NULL;
+    client->next = NULL;
+}
+
+/**
+ * @brief mark the client active by moving it to the end of the idle list
+ *
+ * @param loop
+ * @param client
+ */
+static void touch_client(EventLoop* loop, LoopClient* client)
+{
+    unlink_client(loop, client);
+    client->last_active = time(NULL);
+    client->prev = loop->newest;
+    if (loop->newest != NULL)
+        loop->newest->next = client;
+    loop->newest = client;
+    if (loop->oldest == NULL)
+        loop->oldest = client;
+}
+
+static void close_client(EventLoop* loop, LoopClient* client)
+{
+    unlink_client(loop, client);
+    abort_streamed_request(&client->conn);
+    // Closing the fd also removes it from the epoll set
+    close_connection(&client->conn);
+    FREE(LoopClient, client);
+}
+
+/**
+ * @brief close the clients that haven't sent anything during the idle timeout.
+ * This covers idle persistent connections, clients that stall in the middle
+ * of a request and clients that stop reading their responses.
+ *
+ * @param loop
+ */
+static void expire_clients(EventLoop* loop)
+{
+    int timeout = _server_option_keep_alive_timeout;
+    if (timeout <= 0)
+        return;
+
+    time_t now = time(NULL);
+    while (loop->oldest != NULL && loop->oldest->last_active + timeout <= now)
+        close_client(loop, loop->oldest);
+}
+
+static void accept_clients(EventLoop* loop)
+{
+    for (;;) {
+        int connectfd = accept(loop->socketfd, NULL, NULL);
+        if (connectfd == -1) {
+            if (errno == EINTR)
+                continue;
+            // EAGAIN means that all the pending connections are accepted.
+            // Other errors are client specific so keep on serving.
+            return;
+        }
+
+        if (set_nonblocking(connectfd) == -1) {
+            close(connectfd);
+            continue;
+        }
+
+        LoopClient* client = ALLOCATE(LoopClient, 1);
+        init_connection(&client->conn, connectfd);
+        // Slow clients must not block the others of the loop
+        client->conn.defer_writes = true;
+        client->state = CLIENT_READING;
+        client->close_when_sent = false;
+        client->prev = NULL;
+        client->next = NULL;
+        touch_client(loop, client);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+        ev.data.ptr = client;
+        if (epoll_ctl(loop->epollfd, EPOLL_CTL_ADD, connectfd, &ev) == -1) {
+            perror("epoll_ctl failed");
+            close_client(loop, client);
+        }
+    }
+}
+
+/**
+ * @brief read what the socket has and update the client state.
+ * Edge-triggered events are only reported once so the socket
+ * needs to be drained until recv returns EAGAIN. Reading stops after
+ * EVENT_LOOP_READ_LIMIT bytes so the requests are handled before
+ * the buffer grows further.
+ *
+ * @param client
+ * @return true if the socket may have more to read
+ */
+static bool read_client(LoopClient* client)
+{
+    int total = 0;
+    while (total < EVENT_LOOP_READ_LIMIT) {
+        int n = connection_recv(&client->conn);
+        if (n > 0) {
+            total += n;
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        // Connection closed by the client or an error
+        client->conn.is_alive = false;
+        break;
+    }
+
+    client->state = CLIENT_HANDLING;
+    return total >= EVENT_LOOP_READ_LIMIT;
+}
+
+/**
+ * @brief switch the events the socket of the client is waited for
+ *
+ * @param loop
+ * @param client
+ * @param events EPOLLIN or EPOLLOUT
+ * @return false if epoll_ctl failed
+ */
+static bool watch_client(EventLoop* loop, LoopClient* client, uint32_t events)
+{
+    struct epoll_event ev;
+    ev.events = events | EPOLLET | EPOLLRDHUP;
+    ev.data.ptr = client;
+    return epoll_ctl(loop->epollfd, EPOLL_CTL_MOD, client->conn.conn_fd, &ev) != -1;
+}
+
+/**
+ * @brief handle every complete request in the client buffer.
+ * Responses to pipelined requests are sent with a single write.
+ * If the socket doesn't take them all, the client waits for EPOLLOUT
+ * and the rest of the requests are handled once the responses are sent.
+ *
+ * @param loop
+ * @param client
+ */
+static void handle_client(EventLoop* loop, LoopClient* client)
+{
+    bool keep_alive = handle_buffered_requests(&client->conn);
+    if (!connection_flush(&client->conn)) {
+        client->state = CLIENT_CLOSING;
+        return;
+    }
+
+    if (connection_has_pending(&client->conn)) {
+        client->state = watch_client(loop, client, EPOLLOUT) ? CLIENT_WRITING : CLIENT_CLOSING;
+        client->close_when_sent = !keep_alive;
+        return;
+    }
+    // Client may close its end right after sending the request
+    client->state = keep_alive && client->conn.is_alive ? CLIENT_READING : CLIENT_CLOSING;
+}
+
+/**
+ * @brief read and handle the requests until the socket is drained
+ *
+ * @param loop
+ * @param client
+ */
+static void serve_client(EventLoop* loop, LoopClient* client)
+{
+    // Handle what was read before reading more
+    bool more;
+    do {
+        more = read_client(client);
+        handle_client(loop, client);
+    } while (more && client->state == CLIENT_READING);
+}
+
+/**
+ * @brief send the pending responses and go back to reading once they
+ * are all sent
+ *
+ * @param loop
+ * @param client
+ */
+static void write_client(EventLoop* loop, LoopClient* client)
+{
+    if (!connection_send_pending(&client->conn)) {
+        client->state = CLIENT_CLOSING;
+        return;
+    }
+    if (connection_has_pending(&client->conn))
+        return;
+
+    if (client->close_when_sent || !watch_client(loop, client, EPOLLIN)) {
+        client->state = CLIENT_CLOSING;
+        return;
+    }
+    // Requests received with the previous ones are already in the buffer,
+    // they are handled even if the client has closed its end
+    client->state = CLIENT_READING;
+    serve_client(loop, client);
+}
+
+static void* event_loop(void* loopptr)
+{
+    EventLoop* loop = (EventLoop*)loopptr;
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    memory_use_thread_allocator(_server_option_allocator);
+
+    for (;;) {
+        int n = epoll_wait(loop->epollfd, events, EVENT_LOOP_MAX_EVENTS, EVENT_LOOP_TICK_MS);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait failed");
+            return NULL;
+        }
+
+        for (int i = 0; i < n; i++) {
+            // Listening socket is the only one without a client
+            if (events[i].data.ptr == NULL) {
+                accept_clients(loop);
+                continue;
+            }
+
+            LoopClient* client = (LoopClient*)events[i].data.ptr;
+            if (client->state == CLIENT_WRITING) {
+                // Client may still read after closing its end
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    client->state = CLIENT_CLOSING;
+                } else if (events[i].events & EPOLLOUT) {
+                    touch_client(loop, client);
+                    write_client(loop, client);
+                }
+            } else if (events[i].events & EPOLLIN) {
+                touch_client(loop, client);
+                serve_client(loop, client);
+            } else if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                client->state = CLIENT_CLOSING;
+            }
+
+            if (client->state == CLIENT_CLOSING)
+                close_client(loop, client);
+        }
+
+        expire_clients(loop);
+    }
+
+    return NULL;
+}
+
+static int init_event_loop(EventLoop* loop, int socketfd)
+{
+    loop->socketfd = socketfd;
+    loop->oldest = NULL;
+    loop->newest = NULL;
+    loop->epollfd = epoll_create1(0);
+    if (loop->epollfd == -1) {
+        perror("epoll_create1 failed");
+        return -1;
+    }
+
+    // Every loop waits for the listening socket but EPOLLEXCLUSIVE
+    // wakes up only one of them for each new connection
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(loop->epollfd, EPOLL_CTL_ADD, socketfd, &ev) == -1) {
+        perror("epoll_ctl failed");
+        close(loop->epollfd);
+        return -1;
+    }
+
+    return 0;
+}
+
+int run_event_loop(int socketfd, int threads)
+{
+    if (set_nonblocking(socketfd) == -1) {
+        perror("fcntl(O_NONBLOCK) failed");
+        return EXIT_FAILURE;
+    }
+
+    if (threads < 1)
+        threads = 1;
+
+    EventLoop* loops = ALLOCATE(EventLoop, threads);
+    for (int i = 0; i < threads; i++) {
+        if (init_event_loop(&loops[i], socketfd) == -1)
+            return EXIT_FAILURE;
+    }
+
+    // The calling thread runs the first loop
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&loops[i].thread, NULL, event_loop, &loops[i]) != 0) {
+            perror("thread failed");
+            return EXIT_FAILURE;
+        }
+    }
+    event_loop(&loops[0]);
+
+    for (int i = 1; i < threads; i++)
+        pthread_join(loops[i].thread, NULL);
+    for (int i = 0; i < threads; i++)
+        close(loops[i].epollfd);
+    FREE(EventLoop, loops);
+
+    return EXIT_FAILURE;
+}
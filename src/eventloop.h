@@ -0,0 +1,11 @@
+#ifndef REST_EVENT_LOOP_H_
+#define REST_EVENT_LOOP_H_
+
+/*
+* Serve the connections of the listening socket socketfd with
+* edge-triggered epoll loops, one loop per thread.
+* Returns only if the loops cannot be created.
+*/
+int run_event_loop(int socketfd, int threads);
+
+#endif
@@ -0,0 +1,354 @@
+/**
+ * <fcntl.h>
+ *
+ * functions:
+ * open()
+ */
+#include <fcntl.h>
+
+/**
+ * <unistd.h>
+ *
+ * functions:
+ * close()
+ */
+#include <unistd.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "filecache.h"
+#include "options.h"
+#include "utils/hashtable.h"
+#include "utils/memory.h"
+
+// Seconds before a cached file is compared to the file system again
+#define FILE_CACHE_CHECK_SECONDS 1
+
+// Least recently used entries, newest first
+typedef struct {
+    FileCacheEntry* newest;
+    FileCacheEntry* oldest;
+    int count;
+} EntryList;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static EntryList files = { NULL, NULL, 0 };
+// Missing files are kept apart so looking up paths that don't
+// exist can't evict the open files
+static EntryList missing = { NULL, NULL, 0 };
+
+/*
+* Cached entries of both lists by path. Open addressing on entry->hash
+* with a power of two capacity, the lists only keep the LRU order
+*/
+typedef struct {
+    FileCacheEntry** slots;
+    int capacity;
+    int count;
+} EntryIndex;
+
+static EntryIndex by_path = { NULL, 0, 0 };
+
+static FileCacheEntry* find_entry(const char* path, uint32_t hash)
+{
+    if (by_path.capacity == 0)
+        return NULL;
+    int mask = by_path.capacity - 1;
+    for (int i = hash & mask; by_path.slots[i] != NULL; i = (i + 1) & mask) {
+        FileCacheEntry* entry = by_path.slots[i];
+        if (entry->hash == hash && strcmp(entry->path, path) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+static void index_place(FileCacheEntry** slots, int capacity, FileCacheEntry* entry)
+{
+    int mask = capacity - 1;
+    int i = entry->hash & mask;
+    while (slots[i] != NULL)
+        i = (i + 1) & mask;
+    slots[i] = entry;
+}
+
+static void index_add(FileCacheEntry* entry)
+{
+    if (by_path.count + 1 > by_path.capacity * TABLE_MAX_LOAD) {
+        int capacity = GROW_CAPACITY(by_path.capacity);
+        // Index outlives the arena of the request
+        const Allocator* allocator = memory_use_allocator(NULL);
+        FileCacheEntry** slots = ALLOCATE(FileCacheEntry*, capacity);
+        memset(slots, 0, sizeof(FileCacheEntry*) * capacity);
+        for (int i = 0; i < by_path.capacity; i++) {
+            if (by_path.slots[i] != NULL)
+                index_place(slots, capacity, by_path.slots[i]);
+        }
+        FREE_ARRAY(FileCacheEntry*, by_path.slots, by_path.capacity);
+        memory_use_allocator(allocator);
+        by_path.slots = slots;
+        by_path.capacity = capacity;
+    }
+    index_place(by_path.slots, by_path.capacity, entry);
+    by_path.count++;
+}
+
+/**
+ * @brief remove the entry and move the entries after it back to the
+ * hole if they were placed past it, so lookups need no tombstones
+ *
+ * @param entry
+ */
+static void index_remove(FileCacheEntry* entry)
+{
+    int mask = by_path.capacity - 1;
+    int hole = entry->hash & mask;
+    while (by_path.slots[hole] != entry)
+        hole = (hole + 1) & mask;
+    for (int i = (hole + 1) & mask; by_path.slots[i] != NULL; i = (i + 1) & mask) {
+        int home = by_path.slots[i]->hash & mask;
+        // Slots from home to i are all taken, so the hole is on the way
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            by_path.slots[hole] = by_path.slots[i];
+            hole = i;
+        }
+    }
+    by_path.slots[hole] = NULL;
+    by_path.count--;
+}
+
+static EntryList* entry_list(const FileCacheEntry* entry)
+{
+    return entry->fd != -1 ? &files : &missing;
+}
+
+static void free_entry(FileCacheEntry* entry)
+{
+    if (entry->fd != -1)
+        close(entry->fd);
+    if (entry->response != NULL)
+        FREE_ARRAY(char, entry->response, entry->head_len + entry->st.st_size);
+    FREE_ARRAY(char, entry->path, strlen(entry->path) + 1);
+    FREE(FileCacheEntry, entry);
+}
+
+static void unlink_entry(FileCacheEntry* entry)
+{
+    EntryList* list = entry_list(entry);
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        list->newest = entry->next;
+
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        list->oldest = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void push_entry(FileCacheEntry* entry)
+{
+    EntryList* list = entry_list(entry);
+    entry->prev = NULL;
+    entry->next = list->newest;
+    if (list->newest != NULL)
+        list->newest->prev = entry;
+    list->newest = entry;
+    if (list->oldest == NULL)
+        list->oldest = entry;
+}
+
+/**
+ * @brief remove entry from the cache. The file is closed
+ * when the last user releases it.
+ *
+ * @param entry
+ */
+static void evict_entry(FileCacheEntry* entry)
+{
+    index_remove(entry);
+    unlink_entry(entry);
+    entry->cached = false;
+    entry_list(entry)->count--;
+    if (entry->refs == 0)
+        free_entry(entry);
+}
+
+static bool same_file(struct stat* a, struct stat* b)
+{
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino
+        && a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+/**
+ * @brief open the file for a new entry. Missing files get an entry with
+ * fd -1 so looking them up again doesn't cost an open.
+ *
+ * @param path
+ * @param hash
+ * @return FileCacheEntry*
+ */
+static FileCacheEntry* open_entry(const char* path, uint32_t hash)
+{
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    int fd = open(path, O_RDONLY);
+    // Directories and other special files are not served
+    if (fd != -1 && (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))) {
+        close(fd);
+        fd = -1;
+        memset(&st, 0, sizeof(st));
+    }
+
+    // Entries outlive the arena of the request
+    const Allocator* allocator = memory_use_allocator(NULL);
+    FileCacheEntry* entry = ALLOCATE(FileCacheEntry, 1);
+    int len = (int)strlen(path);
+    entry->path = ALLOCATE(char, len + 1);
+    memory_use_allocator(allocator);
+    memcpy(entry->path, path, len + 1);
+    entry->hash = hash;
+    entry->fd = fd;
+    entry->st = st;
+    entry->checked = time(NULL);
+    entry->response = NULL;
+    entry->head_len = 0;
+    entry->response_tag = 0;
+    entry->refs = 0;
+    entry->cached = false;
+    entry->prev = NULL;
+    entry->next = NULL;
+    return entry;
+}
+
+/**
+ * @brief compare the entry to the file system
+ *
+ * @return true if the entry still matches the file
+ */
+static bool entry_is_valid(FileCacheEntry* entry)
+{
+    struct stat st;
+    if (stat(entry->path, &st) == -1)
+        return entry->fd == -1;
+    return entry->fd != -1 && same_file(&st, &entry->st);
+}
+
+FileCacheEntry* file_cache_acquire(const char* path)
+{
+    uint32_t hash = hash_string(path, (int)strlen(path));
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&cache_lock);
+    FileCacheEntry* entry = find_entry(path, hash);
+
+    // Reopen the file if it has changed since it was opened
+    if (entry != NULL && now - entry->checked >= FILE_CACHE_CHECK_SECONDS) {
+        if (!entry_is_valid(entry)) {
+            evict_entry(entry);
+            entry = NULL;
+        } else {
+            entry->checked = now;
+        }
+    }
+
+    if (entry != NULL) {
+        unlink_entry(entry);
+        push_entry(entry);
+    } else {
+        entry = open_entry(path, hash);
+        if (_server_option_file_cache_size > 0) {
+            // Both lists hold up to file_cache_size entries
+            EntryList* list = entry_list(entry);
+            entry->cached = true;
+            push_entry(entry);
+            index_add(entry);
+            list->count++;
+            if (list->count > _server_option_file_cache_size)
+                evict_entry(list->oldest);
+        }
+    }
+
+    if (entry->fd == -1) {
+        if (!entry->cached)
+            free_entry(entry);
+        entry = NULL;
+    } else {
+        entry->refs++;
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    return entry;
+}
+
+void file_cache_release(FileCacheEntry* entry)
+{
+    pthread_mutex_lock(&cache_lock);
+    entry->refs--;
+    if (entry->refs == 0 && !entry->cached)
+        free_entry(entry);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void file_cache_etag(FileCacheEntry* entry, char* etag)
+{
+    snprintf(etag, FILE_CACHE_ETAG_SIZE, "\"%lx-%lx\"",
+        (unsigned long)entry->st.st_mtime, (unsigned long)entry->st.st_size);
+}
+
+/**
+ * @brief read the whole file to buf
+ *
+ * @return true if all the st_size bytes were read
+ */
+static bool read_file(FileCacheEntry* entry, char* buf)
+{
+    off_t size = entry->st.st_size;
+    off_t pos = 0;
+    // sendfile uses its own offset so moving the file offset is safe
+    if (lseek(entry->fd, 0, SEEK_SET) == -1)
+        return false;
+    while (pos < size) {
+        ssize_t n = read(entry->fd, buf + pos, size - pos);
+        if (n <= 0)
+            return false;
+        pos += n;
+    }
+    return true;
+}
+
+bool file_cache_render(FileCacheEntry* entry, int tag, const char* head, int head_len)
+{
+    pthread_mutex_lock(&cache_lock);
+    // Uncached entries are closed after the response so keeping
+    // their content would only cost a copy
+    if (entry->response == NULL && head_len > 0 && entry->cached
+        && entry->st.st_size <= _server_option_file_cache_memory) {
+        const Allocator* allocator = memory_use_allocator(NULL);
+        char* response = ALLOCATE(char, head_len + entry->st.st_size);
+        memory_use_allocator(allocator);
+        memcpy(response, head, head_len);
+        if (read_file(entry, response + head_len)) {
+            entry->head_len = head_len;
+            entry->response_tag = tag;
+            // Read without the lock by file_cache_rendered
+            __atomic_store_n(&entry->response, response, __ATOMIC_RELEASE);
+        } else {
+            FREE_ARRAY(char, response, head_len + entry->st.st_size);
+        }
+    }
+    bool rendered = entry->response != NULL && entry->response_tag == tag;
+    pthread_mutex_unlock(&cache_lock);
+
+    return rendered;
+}
+
+bool file_cache_rendered(FileCacheEntry* entry, int tag)
+{
+    // The response is set once and kept while the entry has users
+    return __atomic_load_n(&entry->response, __ATOMIC_ACQUIRE) != NULL && entry->response_tag == tag;
+}
@@ -0,0 +1,62 @@
+#ifndef REST_FILE_CACHE_H_
+#define REST_FILE_CACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <time.h>
+
+typedef struct FileCacheEntry {
+    char* path;
+    uint32_t hash;
+    // Open read only file descriptor and its fstat result.
+    // -1 caches the fact that the file doesn't exist
+    int fd;
+    struct stat st;
+    // When st was last compared to the file system
+    time_t checked;
+    // Pre-rendered response: head_len bytes of status line and headers
+    // followed by the file content. NULL until file_cache_render
+    char* response;
+    int head_len;
+    // Identifies the headers the response was rendered with
+    int response_tag;
+    // Amount of users sending the file right now
+    int refs;
+    // Entry is in the cache and not only held by its users
+    bool cached;
+    // Least recently used order, newest first
+    struct FileCacheEntry* prev;
+    struct FileCacheEntry* next;
+} FileCacheEntry;
+
+/*
+* Get the open file for path, opening it only if it's not cached yet.
+* Returns NULL if the path is not a readable regular file.
+* The entry must be given back with file_cache_release
+*/
+FileCacheEntry* file_cache_acquire(const char* path);
+void file_cache_release(FileCacheEntry* entry);
+
+// Quoted ETag and the terminating null
+#define FILE_CACHE_ETAG_SIZE 48
+
+/*
+* Write the ETag of the file, made of its modification time and size, to etag
+*/
+void file_cache_etag(FileCacheEntry* entry, char* etag);
+/*
+* Store head and the file content to entry->response if the file is small
+* enough to be kept in memory. The same file can be served with different
+* headers so tag identifies them. Returns true if entry->response is set
+* and was rendered with the same tag. A head_len of 0 only checks
+* for a response rendered before
+*/
+bool file_cache_render(FileCacheEntry* entry, int tag, const char* head, int head_len);
+/*
+* True if entry->response was rendered with tag. Once true it stays
+* true while the entry is acquired, so the head doesn't need formatting
+*/
+bool file_cache_rendered(FileCacheEntry* entry, int tag);
+
+#endif
@@ -59,13 +59,26 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
+#include "filecache.h"
 #include "http.h"
 #include "options.h"
 #include "server.h"
 #include "socketcon.h"
+#include "utils/arena.h"
+#include "utils/compress.h"
+#include "utils/httpdate.h"
 
 #define SERVER_STR "Server: webasmhttpd/0.0.1\r\n"
+// Responses larger than this are not collected to the out buffer
+#define RESPONSE_BATCH_SIZE 65536
+// Status line and the headers set by the server
+#define RESPONSE_HEAD_SIZE 512
+// Streamed bodies are sent in chunks of at least this size
+#define RESPONSE_CHUNK_SIZE 16384
+// Precompressed siblings of static files have this suffix
+#define GZIP_SUFFIX ".gz"
 
 static Filetype parse_filetype(const char* filepath)
 {
@@ -79,27 +92,132 @@ static Filetype parse_filetype(const char* filepath)
     return FILE_DEFAULT;
 }
 
-static void send_filetype(Response* r, Filetype type)
+static const char* filetype_content_type(Filetype type)
 {
-    char buf[128];
-
     switch (type) {
     case FILE_HTML:
-        strcpy(buf, "Content-Type: text/html\r\n");
-        break;
+        return "text/html";
     case FILE_CSS:
-        strcpy(buf, "Content-Type: text/css\r\n");
-        break;
+        return "text/css";
     case FILE_JS:
-        strcpy(buf, "Content-Type: text/javascript\r\n");
-        break;
+        return "text/javascript";
     default:
         // TODO: figure out better default content type
-        strcpy(buf, "Content-Type: text/html\r\n");
-        break;
+        return "text/html";
+    }
+}
+
+void response_add_header(Response* r, const char* name, const char* value)
+{
+    string_append_chars(&r->headers, name, (int)strlen(name));
+    string_append_chars(&r->headers, ": ", 2);
+    string_append_chars(&r->headers, value, (int)strlen(value));
+    string_append_chars(&r->headers, "\r\n", 2);
+}
+
+/**
+ * @brief close the connection after a response that was cut short.
+ * Responses to the requests after it would be read as a part of it
+ *
+ * @param r
+ */
+static void response_broken(Response* r)
+{
+    r->keep_alive = false;
+    if (r->request != NULL)
+        r->request->keep_alive = false;
+}
+
+/**
+ * @brief send the head, the headers added by the callback, the Connection
+ * header and the body with a single write.
+ * Small responses are collected to the out buffer and sent together with
+ * the responses of the pipelined requests. Otherwise the collected
+ * responses are sent in the same write.
+ *
+ * @param r Response struct
+ * @param head status line and the headers set by the server
+ * @param head_len
+ * @param body body or NULL if the caller sends it by itself
+ * @param body_len
+ * @param flags sendmsg flags
+ */
+static void write_response(Response* r, const char* head, int head_len,
+    const char* body, long body_len, int flags)
+{
+    const char* connection = r->keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    struct iovec iov[5];
+    int iovcnt = 0;
+    size_t total = 0;
+    if (r->out != NULL && r->out->len > 0) {
+        iov[iovcnt].iov_base = r->out->chars;
+        iov[iovcnt++].iov_len = r->out->len;
+    }
+    iov[iovcnt].iov_base = (void*)head;
+    iov[iovcnt++].iov_len = head_len;
+    if (r->headers.len > 0) {
+        iov[iovcnt].iov_base = r->headers.chars;
+        iov[iovcnt++].iov_len = r->headers.len;
+    }
+    iov[iovcnt].iov_base = (void*)connection;
+    iov[iovcnt++].iov_len = strlen(connection);
+    if (body != NULL && body_len > 0) {
+        iov[iovcnt].iov_base = (void*)body;
+        iov[iovcnt++].iov_len = body_len;
+    }
+    for (int i = 0; i < iovcnt; i++)
+        total += iov[i].iov_len;
+
+    // Headers belong to this response only
+    r->headers.len = 0;
+
+    // Caller sends the body by itself so nothing can wait in the buffer
+    if (r->out != NULL && body != NULL && total <= RESPONSE_BATCH_SIZE) {
+        // Out buffer belongs to the connection, not the request arena
+        const Allocator* allocator = memory_use_allocator(NULL);
+        for (int i = r->out->len > 0 ? 1 : 0; i < iovcnt; i++)
+            string_append_chars(r->out, iov[i].iov_base, (int)iov[i].iov_len);
+        memory_use_allocator(allocator);
+        return;
     }
 
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
+    if (!connection_sendv(r->conn, iov, iovcnt, flags))
+        response_broken(r);
+    if (r->out != NULL)
+        r->out->len = 0;
+}
+
+/**
+ * @brief send status line, headers and body with a single write.
+ *
+ * @param r Response struct
+ * @param status status code and reason phrase
+ * @param content_type
+ * @param body body or NULL if the caller sends it by itself
+ * @param content_length length of the body or -1 if unknown
+ * @param flags sendmsg flags
+ */
+static void send_response(Response* r, const char* status, const char* content_type,
+    const char* body, long content_length, int flags)
+{
+    char head[RESPONSE_HEAD_SIZE];
+    int head_len;
+
+    // Body without a known length is framed by closing the connection
+    if (content_length < 0) {
+        r->keep_alive = false;
+        head_len = snprintf(head, RESPONSE_HEAD_SIZE,
+            "HTTP/1.1 %s\r\n" SERVER_STR "Content-Type: %s\r\n",
+            status, content_type);
+    } else {
+        head_len = snprintf(head, RESPONSE_HEAD_SIZE,
+            "HTTP/1.1 %s\r\n" SERVER_STR "Content-Type: %s\r\nContent-Length: %ld\r\n",
+            status, content_type, content_length);
+    }
+    if (head_len >= RESPONSE_HEAD_SIZE)
+        head_len = RESPONSE_HEAD_SIZE - 1;
+
+    write_response(r, head, head_len, body, content_length, flags);
 }
 
 /**
@@ -109,97 +227,598 @@ static void send_filetype(Response* r, Filetype type)
  */
 void http_404(Response* r)
 {
-    char buf[1024];
-
     //TODO: use filename to determine the Content-Type
-
-    strcpy(buf, "HTTP/1.0 404 Not Found\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    strcpy(buf, SERVER_STR);
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    sprintf(buf, "Content-Type: text/html\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    strcpy(buf, "\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
+    send_response(r, "404 Not Found", "text/html", "", 0, 0);
 }
 
 void http_200(Response* r, Filetype type)
 {
-    char buf[256];
+    http_200_length(r, type, -1);
+}
 
-    strcpy(buf, "HTTP/1.0 200 OK\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    strcpy(buf, SERVER_STR);
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    send_filetype(r, type);
-    strcpy(buf, "\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
+void http_200_length(Response* r, Filetype type, long content_length)
+{
+    send_response(r, "200 OK", filetype_content_type(type), NULL, content_length, 0);
 }
 
 void send_json(Response* r, JSONObject* obj)
 {
-    char buf[256];
-
-    strcpy(buf, "HTTP/1.0 200 OK\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    strcpy(buf, SERVER_STR);
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    sprintf(buf, "Content-Type: application/json\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
-    strcpy(buf, "\r\n");
-    send(r->conn.conn_fd, buf, strlen(buf), 0);
     String* str = json_to_string(obj);
-    send(r->conn.conn_fd, str->chars, str->len, 0);
+    const char* body = str->chars;
+    int body_len = str->len;
+
+    // Large bodies are compressed if the client accepts it
+    if (r->request != NULL && r->request->accept_gzip
+        && _server_option_gzip_json_min_size >= 0 && str->len >= _server_option_gzip_json_min_size) {
+        int compressed_len;
+        const char* compressed = gzip_compress(str->chars, str->len, &compressed_len);
+        if (compressed != NULL) {
+            body = compressed;
+            body_len = compressed_len;
+            response_add_header(r, "Content-Encoding", "gzip");
+            response_add_header(r, "Vary", "Accept-Encoding");
+        }
+    }
+    send_response(r, "200 OK", "application/json", body, body_len, 0);
     STRINGP_FREE(str);
 }
 
+void response_begin(Response* r, const char* content_type)
+{
+    if (r->streaming)
+        return;
+    r->streaming = true;
+    r->chunked = r->request != NULL && r->request->http11;
+    if (!r->chunked) {
+        send_response(r, "200 OK", content_type, NULL, -1, MSG_MORE);
+        return;
+    }
+
+    char head[RESPONSE_HEAD_SIZE];
+    int head_len = snprintf(head, RESPONSE_HEAD_SIZE,
+        "HTTP/1.1 200 OK\r\n" SERVER_STR "Content-Type: %s\r\nTransfer-Encoding: chunked\r\n",
+        content_type);
+    if (head_len >= RESPONSE_HEAD_SIZE)
+        head_len = RESPONSE_HEAD_SIZE - 1;
+    // Head waits in the socket for the first chunk
+    write_response(r, head, head_len, NULL, 0, MSG_MORE);
+}
+
+/**
+ * @brief send the collected body and data as one chunk
+ *
+ * @param r
+ * @param data written after the collected body, can be NULL
+ * @param len
+ * @param last end the body after the chunk
+ */
+static void send_chunk(Response* r, const char* data, int len, bool last)
+{
+    static const char last_chunk[] = "0\r\n\r\n";
+    struct iovec iov[5];
+    int iovcnt = 0;
+    char size_line[16];
+    int size = r->body.len + len;
+
+    if (r->chunked && size > 0) {
+        iov[iovcnt].iov_base = size_line;
+        iov[iovcnt++].iov_len = snprintf(size_line, sizeof(size_line), "%x\r\n", size);
+    }
+    if (r->body.len > 0) {
+        iov[iovcnt].iov_base = r->body.chars;
+        iov[iovcnt++].iov_len = r->body.len;
+    }
+    if (len > 0) {
+        iov[iovcnt].iov_base = (void*)data;
+        iov[iovcnt++].iov_len = len;
+    }
+    if (r->chunked && size > 0) {
+        iov[iovcnt].iov_base = (void*)"\r\n";
+        iov[iovcnt++].iov_len = 2;
+    }
+    if (r->chunked && last) {
+        iov[iovcnt].iov_base = (void*)last_chunk;
+        iov[iovcnt++].iov_len = sizeof(last_chunk) - 1;
+    }
+    r->body.len = 0;
+    if (iovcnt > 0 && !connection_sendv(r->conn, iov, iovcnt, 0)) {
+        // Rest of the body is not sent after a lost chunk
+        r->streaming = false;
+        response_broken(r);
+    }
+}
+
+void response_write(Response* r, const char* data, int len)
+{
+    if (!r->streaming || len <= 0)
+        return;
+    if (r->body.len + len < RESPONSE_CHUNK_SIZE) {
+        string_append_chars(&r->body, data, len);
+        return;
+    }
+    // Large writes aren't copied
+    send_chunk(r, data, len, false);
+}
+
+void response_end(Response* r)
+{
+    if (!r->streaming)
+        return;
+    send_chunk(r, NULL, 0, true);
+    r->streaming = false;
+}
+
+static void response_write_json(void* ctx, const char* chars, int len)
+{
+    response_write((Response*)ctx, chars, len);
+}
+
+/**
+ * @brief stop the body of a failed JSON document. The last chunk is
+ * not sent and the connection is closed, so the client sees the
+ * response incomplete
+ *
+ * @param ctx the response
+ */
+static void response_fail_json(void* ctx)
+{
+    Response* r = ctx;
+    r->body.len = 0;
+    r->streaming = false;
+    r->keep_alive = false;
+}
+
+void response_begin_json(Response* r, JSONWriter* w)
+{
+    response_begin(r, "application/json");
+    json_writer_init(w, response_write_json, r);
+    w->fail = response_fail_json;
+}
+
+// Headers a static file is sent with, the tag of file_cache_render
+typedef enum {
+    FILE_IDENTITY,
+    // File has a precompressed sibling the client didn't accept
+    FILE_IDENTITY_VARY,
+    // File is the precompressed sibling
+    FILE_GZIP
+} FileVariant;
+
+/**
+ * @brief status line and the headers of a static file response
+ *
+ * @param file
+ * @param type
+ * @param variant
+ * @param head buffer of RESPONSE_HEAD_SIZE bytes
+ * @return length of the head
+ */
+static int file_head(FileCacheEntry* file, Filetype type, FileVariant variant, char* head)
+{
+    char etag[FILE_CACHE_ETAG_SIZE];
+    char last_modified[HTTP_DATE_SIZE];
+    file_cache_etag(file, etag);
+    format_http_date(file->st.st_mtime, last_modified);
+    int head_len = snprintf(head, RESPONSE_HEAD_SIZE,
+        "HTTP/1.1 200 OK\r\n" SERVER_STR "Content-Type: %s\r\nContent-Length: %ld\r\n"
+        "ETag: %s\r\nLast-Modified: %s\r\n%s",
+        filetype_content_type(type), (long)file->st.st_size, etag, last_modified,
+        variant == FILE_GZIP ? "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n"
+            : variant == FILE_IDENTITY_VARY ? "Vary: Accept-Encoding\r\n"
+                                            : "");
+    if (head_len >= RESPONSE_HEAD_SIZE)
+        head_len = RESPONSE_HEAD_SIZE - 1;
+    return head_len;
+}
+
+/**
+ * @brief check if etag is in the If-None-Match list.
+ * Weak and strong tags are compared the same way.
+ *
+ * @param if_none_match value of the If-None-Match header
+ * @param etag
+ * @return true if the client has the same version
+ */
+static bool etag_matches(const StringSlice* if_none_match, const char* etag)
+{
+    int etag_len = (int)strlen(etag);
+    int i = 0;
+    while (i < if_none_match->len) {
+        const char* tag = if_none_match->chars + i;
+        int len = 0;
+        while (i + len < if_none_match->len && tag[len] != ',')
+            len++;
+        i += len + 1;
+
+        for (; len > 0 && *tag == ' '; tag++, len--)
+            ;
+        for (; len > 0 && tag[len - 1] == ' '; len--)
+            ;
+        if (len >= 2 && strncmp(tag, "W/", 2) == 0) {
+            tag += 2;
+            len -= 2;
+        }
+        if ((len == 1 && *tag == '*') || (len == etag_len && strncmp(tag, etag, len) == 0))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief send 304 instead of the file if the client has the current version
+ *
+ * @param r Response struct
+ * @param file
+ * @param variant Vary is sent like in the 200 response
+ * @return true if 304 was sent
+ */
+static bool send_not_modified(Response* r, FileCacheEntry* file, FileVariant variant)
+{
+    Request* req = r->request;
+    if (req == NULL || req->type != GET)
+        return false;
+
+    char etag[FILE_CACHE_ETAG_SIZE];
+    file_cache_etag(file, etag);
+    // If-Modified-Since is ignored when If-None-Match is sent
+    const StringSlice* if_none_match = request_header_slot(req, HEADER_IF_NONE_MATCH);
+    if (if_none_match != NULL) {
+        if (!etag_matches(if_none_match, etag))
+            return false;
+    } else if (req->if_modified_since == -1 || file->st.st_mtime > req->if_modified_since) {
+        return false;
+    }
+
+    char head[RESPONSE_HEAD_SIZE];
+    char last_modified[HTTP_DATE_SIZE];
+    format_http_date(file->st.st_mtime, last_modified);
+    int head_len = snprintf(head, RESPONSE_HEAD_SIZE,
+        "HTTP/1.1 304 Not Modified\r\n" SERVER_STR "ETag: %s\r\nLast-Modified: %s\r\n%s",
+        etag, last_modified, variant != FILE_IDENTITY ? "Vary: Accept-Encoding\r\n" : "");
+    write_response(r, head, head_len, "", 0, 0);
+    return true;
+}
+
+/**
+ * @brief open the precompressed sibling of filepath
+ *
+ * @param filepath
+ * @return FileCacheEntry* or NULL if there is no sibling
+ */
+static FileCacheEntry* acquire_gzip_file(const char* filepath)
+{
+    int len = (int)strlen(filepath);
+    char gzpath[len + sizeof(GZIP_SUFFIX)];
+    memcpy(gzpath, filepath, len);
+    memcpy(gzpath + len, GZIP_SUFFIX, sizeof(GZIP_SUFFIX));
+    return file_cache_acquire(gzpath);
+}
+
 void send_file(Response* r, const char* filepath)
 {
-    int fd;
     // open the files relative to server
     if (filepath[0] == '/')
-        fd = open(filepath + 1, O_RDONLY);
-    else
-        fd = open(filepath, O_RDONLY);
+        filepath++;
+    // Missing siblings are cached too so trying it is cheap. It is tried
+    // for every client since caches need Vary on both variants
+    FileCacheEntry* file = acquire_gzip_file(filepath);
+    FileVariant variant = file != NULL ? FILE_IDENTITY_VARY : FILE_IDENTITY;
+    if (file != NULL && r->request != NULL && r->request->accept_gzip) {
+        variant = FILE_GZIP;
+    } else {
+        if (file != NULL)
+            file_cache_release(file);
+        file = file_cache_acquire(filepath);
+    }
     // File not found
-    if (fd == -1) {
+    if (file == NULL) {
         http_404(r);
         return;
     }
 
-    struct stat st;
-    fstat(fd, &st);
-    char* file_content = ALLOCATE(char, st.st_size);
-    read(fd, file_content, st.st_size);
+    if (send_not_modified(r, file, variant)) {
+        file_cache_release(file);
+        return;
+    }
 
-    Filetype ftype = parse_filetype(filepath);
-    http_200(r, ftype);
+    // Once rendered the response is never changed so the head
+    // doesn't need to be formatted again
+    char head[RESPONSE_HEAD_SIZE];
+    int head_len = 0;
+    if (!file_cache_rendered(file, variant))
+        head_len = file_head(file, parse_filetype(filepath), variant, head);
 
-    send(r->conn.conn_fd, file_content, st.st_size, 0);
-    free(file_content);
-    close(fd);
+    // Small files are served from the pre-rendered response in memory
+    if (file_cache_render(file, variant, head, head_len)) {
+        write_response(r, file->response, file->head_len,
+            file->response + file->head_len, file->st.st_size, 0);
+        file_cache_release(file);
+        return;
+    }
+
+    if (head_len == 0)
+        head_len = file_head(file, parse_filetype(filepath), variant, head);
+    // MSG_MORE lets the kernel send the headers in the same packet as the file
+    write_response(r, head, head_len, NULL, 0, file->st.st_size > 0 ? MSG_MORE : 0);
+    // Content-Length is already sent, so a short body can only be
+    // told apart from the next response by closing the connection
+    if (!connection_sendfile(r->conn, file->fd, 0, file->st.st_size))
+        response_broken(r);
+    file_cache_release(file);
 }
 
-void* accept_client(void* clientptr)
+/**
+ * @brief send the response of the routed request
+ *
+ * @param conn
+ * @param r
+ * @param au route of the request or NULL for static files
+ * @return true if the connection can be used for the next request
+ */
+// Request scoped allocations of the thread, see set_server_option_request_arena
+static __thread Arena request_arena;
+static __thread Allocator request_arena_allocator;
+
+static bool respond(Connection* conn, Request* r, ApiUrl* au)
 {
-    Connection conn;
-    conn.conn_fd = *((int*)clientptr);
+    const Allocator* previous_allocator = NULL;
+    bool use_arena = _server_option_request_arena_size > 0;
+    if (use_arena) {
+        if (request_arena.block_size == 0) {
+            init_arena(&request_arena, _server_option_request_arena_size);
+            init_arena_allocator(&request_arena_allocator, &request_arena);
+        }
+        previous_allocator = memory_use_allocator(&request_arena_allocator);
+    }
+
     Response resp;
     resp.conn = conn;
-    Request r;
-    init_request(&r);
-    parse_request(&r, &conn);
-    ApiUrl* au = get_call_back(&__rs, &r.uri);
-    if (au != NULL) {
-        parse_paramas(&r, au);
-        (au->callback)(&resp, &r);
+    resp.out = &conn->out;
+    resp.request = r;
+    STRING_INIT(&resp.headers);
+    STRING_INIT(&resp.body);
+    resp.streaming = false;
+    resp.chunked = false;
+    resp.keep_alive = r->keep_alive && conn->is_alive
+        && _server_option_keep_alive_timeout > 0
+        && conn->requests < _server_option_keep_alive_max_requests;
+    // Malformed request, nothing to route
+    if (r->uri.len == 0) {
+        resp.keep_alive = false;
+        http_404(&resp);
     } else {
-        send_file(&resp, r.uri.chars);
+        if (au != NULL)
+            (au->callback)(&resp, r);
+        else
+            send_file(&resp, r->uri.chars);
+        response_end(&resp);
+        if (_server_option_verbose_output)
+            printf("request handled\n");
+    }
+
+    STRING_FREE(&resp.headers);
+    STRING_FREE(&resp.body);
+    if (use_arena) {
+        // JSON view of the parameters may be in the arena
+        if (r->params_json != NULL) {
+            free_json(r->params_json);
+            r->params_json = NULL;
+        }
+        memory_use_allocator(previous_allocator);
+        arena_reset(&request_arena);
     }
-    if (_server_option_verbose_output)
-        printf("request handled\n");
-    close(conn.conn_fd);
-    free_request(&r);
+    return resp.keep_alive;
+}
+
+/**
+ * @brief send 405 with the methods of the url in the Allow header
+ *
+ * @param r
+ * @param req
+ */
+static void send_method_not_allowed(Response* r, Request* req)
+{
+    unsigned allowed;
+    get_method_call_back(&__rs, req->type, &req->uri, &allowed);
+    char allow[64] = "";
+    int len = 0;
+    for (int type = GET; type <= DELETE; type++) {
+        if (allowed & (1u << type))
+            len += snprintf(allow + len, sizeof(allow) - len, "%s%s",
+                len > 0 ? ", " : "", request_type_name(type));
+    }
+    response_add_header(r, "Allow", allow);
+    send_response(r, "405 Method Not Allowed", "text/html", "", 0, 0);
+}
+
+// Route of the urls that have callbacks only for other methods
+static ApiUrl method_not_allowed = { .callback = send_method_not_allowed };
+
+static void send_payload_too_large(Response* r, Request* req)
+{
+    send_response(r, "413 Payload Too Large", "text/html", "", 0, 0);
+}
+
+// Route of the requests with a body over set_server_option_max_body_size
+static ApiUrl payload_too_large = { .callback = send_payload_too_large };
 
-    return NULL;
+/**
+ * @brief find the callback of the request and parse its parameters
+ *
+ * @param r
+ * @return ApiUrl* or NULL if the request is not routed to a callback
+ */
+static ApiUrl* route_request(Request* r)
+{
+    if (r->uri.len == 0)
+        return NULL;
+    unsigned allowed;
+    ApiUrl* au = get_request_call_back(&__rs, r, &allowed);
+    if (au == NULL && allowed != 0)
+        return &method_not_allowed;
+    return au;
+}
+
+bool handle_request(Connection* conn, Request* r)
+{
+    ApiUrl* au = route_request(r);
+    // Bodies of streamed routes are not limited
+    if ((au == NULL || au->body_callback == NULL) && _server_option_max_body_size >= 0
+        && r->content.len > _server_option_max_body_size)
+        au = &payload_too_large;
+    // Whole body of a streamed request arrived at once
+    if (au != NULL && au->body_callback != NULL && r->content.len > 0) {
+        if (!au->body_callback(r, r->content))
+            return false;
+        r->content.chars = NULL;
+        r->content.len = 0;
+    }
+    return respond(conn, r, au);
+}
+
+typedef struct StreamedRequest {
+    Request request;
+    ApiUrl* route;
+    // Where the message was in the connection buffer when the
+    // headers were indexed. The buffer moves when it grows
+    const char* base;
+} StreamedRequest;
+
+typedef enum {
+    // Rest of the body is not received yet
+    STREAM_WAIT,
+    STREAM_DONE,
+    STREAM_CLOSE
+} StreamResult;
+
+static void free_stream(Connection* conn)
+{
+    free_request(&conn->stream->request);
+    FREE(StreamedRequest, conn->stream);
+    conn->stream = NULL;
+}
+
+void abort_streamed_request(Connection* conn)
+{
+    if (conn->stream == NULL)
+        return;
+    StringSlice end = { NULL, 0 };
+    conn->stream->route->body_callback(&conn->stream->request, end);
+    free_stream(conn);
+}
+
+/**
+ * @brief start streaming the body of the incomplete request in
+ * the connection buffer if its route takes the body in parts
+ *
+ * @param conn
+ * @return true if the request is streamed
+ */
+static bool start_stream(Connection* conn)
+{
+    if (__rs.streaming_urls == 0)
+        return false;
+
+    StreamedRequest* s = ALLOCATE(StreamedRequest, 1);
+    init_request(&s->request);
+    if (parse_buffered_head(&s->request, conn)) {
+        s->route = route_request(&s->request);
+        if (s->route != NULL && s->route->body_callback != NULL) {
+            s->base = connection_unread(conn).chars;
+            conn->stream = s;
+            return true;
+        }
+    }
+    free_request(&s->request);
+    FREE(StreamedRequest, s);
+    return false;
+}
+
+/**
+ * @brief pass the received part of the body to the body callback
+ * and respond once the whole body is received
+ *
+ * @param conn
+ * @return StreamResult
+ */
+static StreamResult continue_stream(Connection* conn)
+{
+    StreamedRequest* s = conn->stream;
+    StringSlice part;
+    ParseResult result = buffered_body(conn, &part);
+    if (result == PARSE_FAILED) {
+        abort_streamed_request(conn);
+        return STREAM_CLOSE;
+    }
+
+    const char* base = connection_unread(conn).chars;
+    if (base != s->base) {
+        request_rebase(&s->request, s->base, base);
+        s->base = base;
+    }
+    if (part.len > 0 && !s->route->body_callback(&s->request, part)) {
+        free_stream(conn);
+        return STREAM_CLOSE;
+    }
+    consume_buffered_body(conn);
+    if (result == PARSE_INCOMPLETE)
+        return STREAM_WAIT;
+
+    s->request.content.chars = NULL;
+    s->request.content.len = 0;
+    bool keep_alive = respond(conn, &s->request, s->route);
+    free_stream(conn);
+    return keep_alive ? STREAM_DONE : STREAM_CLOSE;
+}
+
+bool handle_buffered_requests(Connection* conn)
+{
+    for (;;) {
+        // Next requests wait until the client has taken the responses
+        if (connection_has_pending(conn))
+            return true;
+        if (conn->stream != NULL) {
+            StreamResult result = continue_stream(conn);
+            if (result == STREAM_WAIT)
+                return true;
+            if (result == STREAM_CLOSE)
+                return false;
+            continue;
+        }
+
+        Request r;
+        init_request(&r);
+        if (parse_buffered_request(&r, conn)) {
+            bool keep_alive = handle_request(conn, &r);
+            free_request(&r);
+            if (!keep_alive)
+                return false;
+            continue;
+        }
+        if (!start_stream(conn)) {
+            // Refused before the whole body fills the buffer
+            bool too_large = parse_too_large_request(&r, conn);
+            if (too_large)
+                respond(conn, &r, &payload_too_large);
+            free_request(&r);
+            return !too_large;
+        }
+        free_request(&r);
+    }
+}
+
+void accept_client(int connectfd, WorkQueue* waiting)
+{
+    Connection conn;
+    init_connection(&conn, connectfd);
+    // Client closed the connection or it was idle for too long
+    while (receive_request(&conn, waiting)) {
+        if (!handle_buffered_requests(&conn))
+            break;
+        // Responses to pipelined requests are sent together
+        if (!connection_flush(&conn))
+            break;
+    }
+    abort_streamed_request(&conn);
+    close_connection(&conn);
 }
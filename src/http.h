@@ -11,15 +11,71 @@ typedef enum {
     FILE_JS
 } Filetype;
 
+/*
+* Add a header to the next response sent with resp.
+* Call before sending the response
+*/
+void response_add_header(Response* resp, const char* name, const char* value);
 void http_404(Response* resp);
+/*
+* Send 200 header without a Content-Length. The body is framed by
+* closing the connection after the response.
+*/
 void http_200(Response* r, Filetype type);
+/*
+* Send 200 header for a body of content_length bytes
+*/
+void http_200_length(Response* r, Filetype type, long content_length);
 void send_json(Response* resp, JSONObject* obj);
 /*
+* Start a 200 response whose body is written in parts with
+* response_write and finished with response_end. HTTP/1.1 clients get
+* it with Transfer-Encoding: chunked, the connection of older clients
+* is closed after the body.
+* Small writes are collected and sent as RESPONSE_CHUNK_SIZE chunks
+*/
+void response_begin(Response* r, const char* content_type);
+void response_write(Response* r, const char* data, int len);
+/*
+* Send the rest of the body. Called after the callback returns if the
+* callback doesn't call it
+*/
+void response_end(Response* r);
+/*
+* Start a JSON response written piece by piece with w.
+* Finish the document and call response_end. Nesting deeper than
+* JSON_WRITER_MAX_DEPTH or a number that isn't finite fails the
+* response, the client gets it incomplete and the connection is closed
+*/
+void response_begin_json(Response* r, JSONWriter* w);
+/*
 * Send a file content basend on the filetype (.html, .css, .js etc)
 * Send 404 if file is not found
 */
 void send_file(Response* r, const char* filepath);
 
-void* accept_client(void* clientptr);
+/*
+* Route the parsed request to its callback or to a static file.
+* Returns true if the connection can be used for the next request
+*/
+bool handle_request(Connection* conn, Request* r);
+/*
+* Handle every complete request in the connection buffer. Bodies of the
+* urls added with add_url_streaming are passed to their callback as far
+* as they are received. Stops while output of the connection is pending.
+* Returns false if the connection must be closed
+*/
+bool handle_buffered_requests(Connection* conn);
+/*
+* Tell the callback of an incomplete streamed request that the rest of
+* the body won't come. Call before closing the connection
+*/
+void abort_streamed_request(Connection* conn);
+/*
+* Handle the requests of the connection until it's closed or idle for
+* too long. Idle connections are closed early while connections are
+* waiting for a thread in waiting, NULL keeps them for the whole timeout
+*/
+void accept_client(int connectfd, WorkQueue* waiting);
 
 #endif
@@ -1,7 +1,20 @@
 #ifndef REST_OPTIONS_H_
 #define REST_OPTIONS_H_
 
+#include "utils/memory.h"
+
 extern volatile int _server_option_verbose_output;
 extern volatile unsigned short _server_option_tcp_port;
+extern volatile int _server_option_event_loop_threads;
+extern volatile int _server_option_worker_threads;
+extern volatile int _server_option_worker_queue_size;
+extern volatile int _server_option_keep_alive_timeout;
+extern volatile int _server_option_keep_alive_max_requests;
+extern volatile int _server_option_file_cache_size;
+extern volatile long _server_option_file_cache_memory;
+extern volatile int _server_option_gzip_json_min_size;
+extern volatile int _server_option_request_arena_size;
+extern volatile long _server_option_max_body_size;
+extern const Allocator* volatile _server_option_allocator;
 
 #endif
@@ -0,0 +1,316 @@
+#include <limits.h>
+#include <string.h>
+
+#include "../utils/scan.h"
+#include "parser.h"
+
+void init_request_parser(RequestParser* p)
+{
+    p->state = PARSE_REQUEST_LINE;
+    p->line_start = 0;
+    p->scanned = 0;
+    p->request_line_start = 0;
+    p->request_line_len = 0;
+    p->headers_start = 0;
+    p->content_start = 0;
+    p->content_length = 0;
+    p->chunked = false;
+    p->chunk_left = 0;
+    p->body_len = 0;
+    p->discarded = 0;
+    p->length = 0;
+    p->head_checked = false;
+}
+
+bool header_name_is(const char* line, int len, const char* name)
+{
+    int i;
+    for (i = 0; name[i] != '\0'; i++) {
+        if (i >= len)
+            return false;
+        char c = line[i];
+        char n = name[i];
+        if (c >= 'A' && c <= 'Z')
+            c = c - 'A' + 'a';
+        if (n >= 'A' && n <= 'Z')
+            n = n - 'A' + 'a';
+        if (c != n)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief parse the value of Content-Length
+ *
+ * @param value
+ * @param len
+ * @return the length or -1 if the value is not a valid number
+ */
+static int parse_content_length(const char* value, int len)
+{
+    for (; len > 0 && (*value == ' ' || *value == '\t'); value++, len--)
+        ;
+    for (; len > 0 && (value[len - 1] == ' ' || value[len - 1] == '\t'); len--)
+        ;
+    if (len == 0)
+        return -1;
+
+    int content_length = 0;
+    for (int i = 0; i < len; i++) {
+        if (value[i] < '0' || value[i] > '9')
+            return -1;
+        if (content_length > (INT_MAX - (value[i] - '0')) / 10)
+            return -1;
+        content_length = content_length * 10 + (value[i] - '0');
+    }
+    return content_length;
+}
+
+/**
+ * @brief parse the size line of a chunk. Extensions after ';' are ignored.
+ *
+ * @param line
+ * @param len
+ * @return the size or -1 if the line is not a valid size
+ */
+static int parse_chunk_size(const char* line, int len)
+{
+    int size = 0;
+    int i = 0;
+    for (; i < len; i++) {
+        char c = line[i];
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            break;
+        if (size > (INT_MAX - digit) / 16)
+            return -1;
+        size = size * 16 + digit;
+    }
+    if (i == 0 || (i < len && line[i] != ';' && line[i] != ' ' && line[i] != '\t'))
+        return -1;
+    return size;
+}
+
+/**
+ * @brief check that chunked is the last transfer coding. Bodies with
+ * other codings can't be framed so they are refused.
+ *
+ * @param value value of the Transfer-Encoding header
+ * @param len
+ * @return true if the body is chunked
+ */
+static bool is_chunked(const char* value, int len)
+{
+    for (; len > 0 && (value[len - 1] == ' ' || value[len - 1] == '\t'); len--)
+        ;
+    return len >= 7 && header_name_is(value + len - 7, 7, "chunked")
+        && (len == 7 || value[len - 8] == ',' || value[len - 8] == ' ' || value[len - 8] == ':');
+}
+
+/**
+ * @brief handle a complete line of the head or the chunked framing
+ *
+ * @param p
+ * @param line
+ * @param len length without the line break
+ * @param next where the next line starts
+ */
+static void parse_line(RequestParser* p, const char* line, int len, int next)
+{
+    switch (p->state) {
+    case PARSE_REQUEST_LINE:
+        // Empty lines before the request line are ignored
+        if (len == 0)
+            return;
+        p->request_line_start = p->line_start;
+        p->request_line_len = len;
+        p->headers_start = next;
+        p->state = PARSE_HEADERS;
+        return;
+    case PARSE_HEADERS:
+        // Empty line ends the headers
+        if (len == 0) {
+            p->content_start = next;
+            p->state = p->chunked ? PARSE_CHUNK_SIZE : PARSE_CONTENT;
+        } else if (header_name_is(line, len, "content-length:")) {
+            p->content_length = parse_content_length(line + 15, len - 15);
+            if (p->content_length == -1)
+                p->state = PARSE_ERROR;
+        } else if (header_name_is(line, len, "transfer-encoding:")) {
+            // Transfer-Encoding overrides Content-Length
+            p->chunked = is_chunked(line + 18, len - 18);
+            if (!p->chunked)
+                p->state = PARSE_ERROR;
+        }
+        return;
+    case PARSE_CHUNK_SIZE: {
+        int size = parse_chunk_size(line, len);
+        if (size == -1 || size > INT_MAX - p->body_len) {
+            p->state = PARSE_ERROR;
+        } else if (size == 0) {
+            p->state = PARSE_TRAILERS;
+        } else {
+            p->chunk_left = size;
+            p->state = PARSE_CHUNK_DATA;
+        }
+        return;
+    }
+    case PARSE_CHUNK_END:
+        // Chunk data is followed by a line break only
+        p->state = len == 0 ? PARSE_CHUNK_SIZE : PARSE_ERROR;
+        return;
+    case PARSE_TRAILERS:
+        // Trailer fields are not used, empty line ends the message
+        if (len == 0) {
+            p->length = next;
+            p->state = PARSE_DONE;
+        }
+        return;
+    default:
+        return;
+    }
+}
+
+/**
+ * @brief move the received part of the current chunk next to the
+ * previous chunks so the body is contiguous
+ *
+ * @param p
+ * @param m
+ * @param len
+ * @return false if more data is needed
+ */
+static bool decode_chunk(RequestParser* p, char* m, int len)
+{
+    int n = len - p->line_start;
+    if (n <= 0)
+        return false;
+    if (n > p->chunk_left)
+        n = p->chunk_left;
+
+    int end = p->content_start + p->body_len;
+    if (end != p->line_start)
+        memmove(m + end, m + p->line_start, n);
+    p->body_len += n;
+    p->chunk_left -= n;
+    p->line_start += n;
+    p->scanned = p->line_start;
+    if (p->chunk_left == 0)
+        p->state = PARSE_CHUNK_END;
+    return true;
+}
+
+/**
+ * @brief find the next complete line and parse it
+ *
+ * @param p
+ * @param m
+ * @param len
+ * @return false if more data is needed
+ */
+static bool parse_next_line(RequestParser* p, const char* m, int len)
+{
+    int i = p->scanned + scan_find_any(m + p->scanned, len - p->scanned, "\n", 1);
+    // Everything scanned so far belongs to the head. Lines of the
+    // chunked framing are limited one by one
+    int limit_start = p->state == PARSE_REQUEST_LINE || p->state == PARSE_HEADERS ? 0 : p->line_start;
+    if (i - limit_start >= REQUEST_MAX_HEAD_SIZE) {
+        p->state = PARSE_ERROR;
+        return false;
+    }
+    if (i == len) {
+        p->scanned = len;
+        return false;
+    }
+
+    int line_len = i - p->line_start;
+    if (line_len > 0 && m[i - 1] == '\r')
+        line_len--;
+    parse_line(p, m + p->line_start, line_len, i + 1);
+    p->line_start = i + 1;
+    p->scanned = i + 1;
+    return true;
+}
+
+ParseResult request_parser_feed(RequestParser* p, char* m, int len)
+{
+    bool progress = true;
+    while (progress) {
+        switch (p->state) {
+        case PARSE_CONTENT: {
+            progress = false;
+            int left = p->content_length - p->discarded;
+            if (len - p->content_start >= left) {
+                p->body_len = left;
+                p->length = p->content_start + left;
+                p->state = PARSE_DONE;
+            } else {
+                p->body_len = len - p->content_start;
+            }
+            break;
+        }
+        case PARSE_CHUNK_DATA:
+            progress = decode_chunk(p, m, len);
+            break;
+        case PARSE_DONE:
+        case PARSE_ERROR:
+            progress = false;
+            break;
+        default:
+            progress = parse_next_line(p, m, len);
+            break;
+        }
+    }
+
+    switch (p->state) {
+    case PARSE_DONE:
+        return PARSE_COMPLETE;
+    case PARSE_ERROR:
+        return PARSE_FAILED;
+    default:
+        return PARSE_INCOMPLETE;
+    }
+}
+
+int request_parser_length(const RequestParser* p)
+{
+    return p->length;
+}
+
+bool request_parser_has_head(const RequestParser* p)
+{
+    return p->state != PARSE_REQUEST_LINE && p->state != PARSE_HEADERS && p->state != PARSE_ERROR;
+}
+
+long request_parser_body_size(const RequestParser* p)
+{
+    if (!request_parser_has_head(p))
+        return 0;
+    if (!p->chunked)
+        return p->content_length;
+    return (long)p->discarded + p->body_len + p->chunk_left;
+}
+
+int request_parser_discard_body(RequestParser* p, char* m, int len)
+{
+    int end = p->content_start + p->body_len;
+    memmove(m + p->content_start, m + end, len - end);
+    // Content-Length bodies don't use the line offsets
+    if (p->chunked) {
+        p->line_start -= p->body_len;
+        p->scanned -= p->body_len;
+    }
+    if (p->state == PARSE_DONE)
+        p->length -= p->body_len;
+    p->discarded += p->body_len;
+    len -= p->body_len;
+    p->body_len = 0;
+    return len;
+}
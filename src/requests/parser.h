@@ -0,0 +1,92 @@
+#ifndef REST_PARSER_H_
+#define REST_PARSER_H_
+
+#include <stdbool.h>
+
+// Longest request line and headers accepted
+#define REQUEST_MAX_HEAD_SIZE 65536
+
+typedef enum {
+    PARSE_REQUEST_LINE,
+    PARSE_HEADERS,
+    // Content-Length bytes of body
+    PARSE_CONTENT,
+    // Transfer-Encoding: chunked body
+    PARSE_CHUNK_SIZE,
+    PARSE_CHUNK_DATA,
+    PARSE_CHUNK_END,
+    PARSE_TRAILERS,
+    PARSE_DONE,
+    PARSE_ERROR
+} ParseState;
+
+typedef enum {
+    // Message is incomplete, feed it again when more is received
+    PARSE_INCOMPLETE,
+    PARSE_COMPLETE,
+    // Message is malformed or too large
+    PARSE_FAILED
+} ParseResult;
+
+/*
+* Finds where the parts of a request are while it is received.
+* Every byte is scanned only once however many pieces the request
+* arrives in. Offsets are relative to the start of the message.
+* Chunked bodies are decoded in place so the body is always the
+* body_len bytes at content_start.
+*/
+typedef struct {
+    ParseState state;
+    // Where the current line starts and how far it is scanned
+    int line_start;
+    int scanned;
+    int request_line_start;
+    int request_line_len;
+    int headers_start;
+    int content_start;
+    int content_length;
+    bool chunked;
+    // Bytes of the current chunk that are not received yet
+    int chunk_left;
+    // Bytes of the body received and decoded so far
+    int body_len;
+    // Bytes of the body removed with request_parser_discard_body
+    int discarded;
+    // Length of the whole message once it's complete
+    int length;
+    // Head of the incomplete request has been routed
+    bool head_checked;
+} RequestParser;
+
+void init_request_parser(RequestParser* p);
+/*
+* Continue parsing the message from where the previous call stopped.
+* The message must start at the same byte on every call, only more
+* bytes can be added to its end. Chunked bodies are modified.
+*/
+ParseResult request_parser_feed(RequestParser* p, char* m, int len);
+/*
+* Length of the whole message once it is complete
+*/
+int request_parser_length(const RequestParser* p);
+/*
+* True once the request line and the headers are parsed
+*/
+bool request_parser_has_head(const RequestParser* p);
+/*
+* Size of the body as far as the head and the framing tell it:
+* Content-Length, or the chunks received so far and the rest of the
+* current chunk. Includes the discarded bytes
+*/
+long request_parser_body_size(const RequestParser* p);
+/*
+* Remove the body_len bytes of body from the message so the rest of the
+* body can be received to the same memory. Returns the new length of m
+*/
+int request_parser_discard_body(RequestParser* p, char* m, int len);
+/*
+* Case insensitive compare of the name in the beginning of line
+*/
+bool header_name_is(const char* line, int len, const char* name);
+
+#endif
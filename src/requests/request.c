@@ -1,4 +1,6 @@
+#include <errno.h>
 #include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,198 +9,670 @@
 
 #include "../datatypes.h"
 #include "../options.h"
+#include "../utils/httpdate.h"
 #include "../utils/memory.h"
+#include "../utils/scan.h"
+#include "parser.h"
 #include "request.h"
 
-typedef struct {
-    char* message;
-    int len;
-    int capacity;
-} RequestMessage;
+// How long to wait for the rest of the request
+#define REQUEST_READ_TIMEOUT_MS 5000
+// How often an idle connection checks for connections waiting for its thread
+#define REQUEST_IDLE_CHECK_MS 100
 
-static void init_message(RequestMessage* m)
+/**
+ * @brief read from the connection until its buffer holds a complete request.
+ * The parser continues from where it stopped after every read.
+ *
+ * @param conn
+ * @param timeout milliseconds to wait for each read
+ * @return true if there is a complete or a malformed request in the buffer
+ */
+static bool read_full_request(Connection* conn, int timeout)
 {
-    m->message = NULL;
-    m->len = 0;
-    m->capacity = 0;
+    int n;
+    struct pollfd fd;
+    fd.fd = conn->conn_fd;
+    fd.events = POLLIN;
+
+    while (!has_buffered_request(conn)) {
+        // The rest of the body would only fill the memory
+        if (buffered_body_too_large(conn))
+            return false;
+        n = poll(&fd, 1, timeout);
+
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n <= 0) // Error in poll or client is too slow
+            return false;
+
+        n = connection_recv(conn);
+
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n <= 0) // Client closed the connection or an error
+            return false;
+    }
+
+    return true;
 }
 
-static void free_message(RequestMessage* m)
+void free_request(Request* r)
 {
-    FREE(char, m->message);
+    STRING_FREE(&r->uri);
+    request_reserve_params(r, 0);
+}
+
+void init_request(Request* r)
+{
+    // Type is -1 by default to indicate possible error
+    r->type = -1;
+    r->keep_alive = false;
+    r->http11 = false;
+    r->path_params_spill = NULL;
+    r->path_params_spill_size = 0;
+    r->path_param_names = NULL;
+    r->path_param_count = 0;
+    r->params_json = NULL;
+    r->if_modified_since = -1;
+    r->accept_gzip = false;
+    r->user_data = NULL;
+    r->header_count = 0;
+    for (int i = 0; i < HEADER_SLOT_COUNT; i++)
+        r->header_slots[i] = -1;
+    STRING_INIT(&r->uri);
+    r->query.chars = NULL;
+    r->query.len = 0;
+    r->content.chars = NULL;
+    r->content.len = 0;
 }
 
 /**
- * @brief read characters to buffer fron start index to '\n' character or to message end
+ * @brief parse the method, the uri and the version from the request line.
+ * Requests with unknown methods are left without uri so they are not routed.
  *
- * @param conn
- * @param buffer
- * @param start
- * @return int where the line ended
+ * @param r
+ * @param line request line without the line break
+ * @param len
  */
-static int read_line(String* m, String* buffer, int start)
+static void parse_request_line(Request* r, const char* line, int len)
 {
-    int i = start;
-    char c = 0;
+    int method_len = scan_find_any(line, len, " ", 1);
+    if (method_len >= len)
+        return;
 
-    while (i < m->len) {
-        c = m->chars[i];
+    if (method_len == 3 && strncmp(line, "GET", 3) == 0)
+        r->type = GET;
+    else if (method_len == 3 && strncmp(line, "PUT", 3) == 0)
+        r->type = PUT;
+    else if (method_len == 4 && strncmp(line, "POST", 4) == 0)
+        r->type = POST;
+    else if (method_len == 6 && strncmp(line, "DELETE", 6) == 0)
+        r->type = DELETE;
+    else
+        return;
+
+    const char* uri = line + method_len + 1;
+    int rest = len - method_len - 1;
+    int uri_len = scan_find_any(uri, rest, " ", 1);
+    // Terminate the uri with null without counting it to the length
+    string_append_chars(&r->uri, uri, uri_len);
+    // Query string stays in the same chars after the path
+    const char* query = memchr(r->uri.chars, '?', uri_len);
+    if (query != NULL) {
+        r->uri.len = (int)(query - r->uri.chars);
+        r->uri.chars[r->uri.len] = '\0';
+        r->query.chars = query + 1;
+        r->query.len = uri_len - r->uri.len - 1;
+    }
+
+    // HTTP/1.1 connections are persistent by default
+    const char* version = uri + uri_len + 1;
+    int version_len = rest - uri_len - 1;
+    r->http11 = version_len == 8 && strncmp(version, "HTTP/1.1", 8) == 0;
+    r->keep_alive = r->http11;
+}
 
-        // ignore the \r
-        if (c == '\r')
+/**
+ * @brief check if the Accept-Encoding list allows coding.
+ * Codings with q=0 are refused, other weights are not compared.
+ *
+ * @param value value of the Accept-Encoding header
+ * @param len
+ * @param coding lowercase name of the coding
+ * @return true if the coding is accepted
+ */
+static bool accepts_encoding(const char* value, int len, const char* coding)
+{
+    int coding_len = (int)strlen(coding);
+    int i = 0;
+    while (i < len) {
+        const char* token = value + i;
+        int token_len = 0;
+        while (i + token_len < len && token[token_len] != ',')
+            token_len++;
+        i += token_len + 1;
+
+        for (; token_len > 0 && *token == ' '; token++, token_len--)
+            ;
+        int name_len = 0;
+        while (name_len < token_len && token[name_len] != ';' && token[name_len] != ' ')
+            name_len++;
+        if (!(name_len == 1 && *token == '*')
+            && !(name_len == coding_len && header_name_is(token, name_len, coding)))
             continue;
-        // when \n is found
-        if (c == '\n')
-            break;
 
-        STRING_APPEND(buffer, c);
-        i++;
+        // Find the weight after the name
+        const char* q = token + name_len;
+        int q_len = token_len - name_len;
+        for (; q_len > 0 && (*q == ' ' || *q == ';'); q++, q_len--)
+            ;
+        if (q_len >= 2 && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=') {
+            bool zero = true;
+            for (int j = 2; j < q_len && q[j] != ' '; j++) {
+                if (q[j] != '0' && q[j] != '.')
+                    zero = false;
+            }
+            if (zero)
+                continue;
+        }
+        return true;
     }
+    return false;
+}
 
-    // Terminate the string with null
-    STRING_APPEND(buffer, '\0');
+// Lowercase names of the headers in HeaderSlot order
+static const char* const header_slot_names[HEADER_SLOT_COUNT] = {
+    "content-length",
+    "connection",
+    "accept-encoding",
+    "host",
+    "if-none-match",
+    "if-modified-since",
+};
 
-    return i;
+/**
+ * @brief case insensitive compare of a whole header name or value
+ *
+ * @param slice
+ * @param name
+ * @return true if the names are equal
+ */
+static bool header_name_equals(const StringSlice* slice, const char* name)
+{
+    return (int)strlen(name) == slice->len && header_name_is(slice->chars, slice->len, name);
 }
 
-static void read_full_request(Connection* conn, String* m)
+/**
+ * @brief add the header line to the header index
+ *
+ * @param r
+ * @param line start of the header line
+ * @param len length of the line without the line break
+ */
+static void index_header(Request* r, const char* line, int len)
 {
-    int ret;
-    char c;
-    int n;
-    struct pollfd fd;
-    fd.fd = conn->conn_fd; // your socket handler
-    fd.events = POLLIN;
-
-    for (;;) {
-        ret = poll(&fd, 1, 10); // 10 milliseconds for timeout //TODO: timeout should be tested
-
-        if (ret == -1) // Error in poll
+    if (r->header_count >= REQUEST_MAX_HEADERS)
+        return;
+
+    int name_len = scan_find_any(line, len, ":", 1);
+    if (name_len == 0 || name_len == len)
+        return;
+    const char* colon = line + name_len;
+
+    Header* h = &r->headers[r->header_count];
+    h->name.chars = line;
+    h->name.len = (int)(colon - line);
+    h->value.chars = colon + 1;
+    h->value.len = len - h->name.len - 1;
+    for (; h->value.len > 0 && (*h->value.chars == ' ' || *h->value.chars == '\t'); h->value.chars++, h->value.len--)
+        ;
+    for (; h->value.len > 0 && (h->value.chars[h->value.len - 1] == ' ' || h->value.chars[h->value.len - 1] == '\t'); h->value.len--)
+        ;
+
+    // The first one of repeated headers is used
+    for (int i = 0; i < HEADER_SLOT_COUNT; i++) {
+        if (r->header_slots[i] == -1 && header_name_equals(&h->name, header_slot_names[i])) {
+            r->header_slots[i] = r->header_count;
             break;
+        }
+    }
+    r->header_count++;
+}
 
-        if (ret == 0) // poll has reached timeout
+/**
+ * @brief index the headers and parse the ones the server uses.
+ * HTTP/1.1 connections are persistent unless the client sends
+ * "Connection: close". HTTP/1.0 connections need "Connection: keep-alive".
+ *
+ * @param r
+ * @param m message
+ * @param line_start where the first header line starts
+ * @param end where the headers end
+ */
+static void parse_headers(Request* r, const char* m, int line_start, int end)
+{
+    while (line_start < end) {
+        int i = line_start + scan_find_any(m + line_start, end - line_start, "\n", 1);
+        const char* header = m + line_start;
+        int len = i - line_start;
+        if (len > 0 && header[len - 1] == '\r')
+            len--;
+        line_start = i + 1;
+        // Empty line ends the headers
+        if (len == 0)
             break;
+        index_header(r, header, len);
+    }
 
-        n = recv(conn->conn_fd, &c, 1, 0);
+    const StringSlice* value = request_header_slot(r, HEADER_CONNECTION);
+    if (value != NULL) {
+        if (header_name_equals(value, "close"))
+            r->keep_alive = false;
+        else if (header_name_equals(value, "keep-alive"))
+            r->keep_alive = true;
+    }
+    value = request_header_slot(r, HEADER_IF_MODIFIED_SINCE);
+    if (value != NULL)
+        r->if_modified_since = parse_http_date(value->chars, value->len);
+    value = request_header_slot(r, HEADER_ACCEPT_ENCODING);
+    if (value != NULL)
+        r->accept_gzip = accepts_encoding(value->chars, value->len, "gzip");
+}
 
-        if (n == -1)
-            break; // TODO: Should we report an error?
+const StringSlice* request_header(const Request* r, const char* name)
+{
+    for (int i = 0; i < r->header_count; i++) {
+        if (header_name_equals(&r->headers[i].name, name))
+            return &r->headers[i].value;
+    }
+    return NULL;
+}
 
-        if (n == 0)
-            break; // TODO: Should we report an error?
+const StringSlice* request_header_slot(const Request* r, HeaderSlot slot)
+{
+    int i = r->header_slots[slot];
+    return i != -1 ? &r->headers[i].value : NULL;
+}
 
-        // Hopefully message ends in null
-        if (c == '\0')
-            break;
+void request_query_iterator(const Request* r, QueryIterator* it)
+{
+    it->pos = r->query.chars;
+    it->end = r->query.chars + r->query.len;
+}
 
-        // ignore the \r
-        if (c == '\r')
-            continue;
+bool query_next(QueryIterator* it, StringSlice* name, StringSlice* value)
+{
+    // Empty pairs of && are skipped
+    while (it->pos < it->end && *it->pos == '&')
+        it->pos++;
+    if (it->pos >= it->end)
+        return false;
+
+    const char* amp = memchr(it->pos, '&', it->end - it->pos);
+    const char* pair_end = amp != NULL ? amp : it->end;
+    const char* eq = memchr(it->pos, '=', pair_end - it->pos);
+    name->chars = it->pos;
+    name->len = (int)((eq != NULL ? eq : pair_end) - it->pos);
+    value->chars = eq != NULL ? eq + 1 : pair_end;
+    value->len = (int)(pair_end - value->chars);
+    it->pos = pair_end;
+    return true;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @brief decode the character at s[*i] and move i past it.
+ * Malformed escapes are kept as they are.
+ *
+ * @param s
+ * @param len
+ * @param i
+ * @return decoded character
+ */
+static char decode_char(const char* s, int len, int* i)
+{
+    char c = s[(*i)++];
+    if (c == '+')
+        return ' ';
+    // Two hex digits must follow
+    if (c != '%' || *i + 2 > len)
+        return c;
+    int high = hex_value(s[*i]);
+    int low = hex_value(s[*i + 1]);
+    if (high < 0 || low < 0)
+        return c;
+    *i += 2;
+    return (char)(high << 4 | low);
+}
 
-        STRING_APPEND(m, c);
+int url_decode(const char* s, int len, char* out, int out_size)
+{
+    int n = 0;
+    int i = 0;
+    while (i < len) {
+        if (n + 1 >= out_size)
+            return -1;
+        out[n++] = decode_char(s, len, &i);
     }
+    if (out_size < 1)
+        return -1;
+    out[n] = '\0';
+    return n;
 }
 
-static void parse_content(Request* r, String* m)
+/**
+ * @brief compare an encoded query name to a plain one without decoding
+ * it to a buffer
+ *
+ * @param encoded
+ * @param name
+ * @return true if they are equal
+ */
+static bool query_name_equals(const StringSlice* encoded, const char* name)
 {
-    //TODO: make sure that there is a content lenght and the data matches the length
-    // Go through message until you get the empty line
-    int i, line_len = 0;
-    for (i = 0; i < m->len; i++) {
-        if (m->chars[i] == '\n') {
-            if (line_len == 0)
-                break;
-            else
-                line_len = 0;
-        } else {
-            line_len++;
-        }
+    int i = 0;
+    while (i < encoded->len) {
+        if (*name == '\0' || decode_char(encoded->chars, encoded->len, &i) != *name)
+            return false;
+        name++;
     }
+    return *name == '\0';
+}
 
-    for (; i < m->len; i++) {
-        STRING_APPEND(&r->content, m->chars[i]);
+int request_query(const Request* r, const char* name, char* buf, int buf_size)
+{
+    QueryIterator it;
+    StringSlice pair_name;
+    StringSlice value;
+    request_query_iterator(r, &it);
+    while (query_next(&it, &pair_name, &value)) {
+        if (query_name_equals(&pair_name, name))
+            return url_decode(value.chars, value.len, buf, buf_size);
     }
+    return -1;
 }
 
-static void parse_request_type(Request* r, String* line)
+static const StringSlice* path_params(const Request* r)
 {
-    char buf[16];
+    return r->path_params_spill != NULL ? r->path_params_spill : r->path_params;
+}
 
-    for (int i = 0; line->chars[i] != ' ' && i < line->len; i++) {
-        buf[i] = line->chars[i];
+const StringSlice* request_param(const Request* r, const char* name)
+{
+    const StringSlice* values = path_params(r);
+    int len = (int)strlen(name);
+    for (int i = 0; i < r->path_param_count; i++) {
+        const String* param = r->path_param_names[i];
+        if (param->len == len && memcmp(param->chars, name, len) == 0)
+            return &values[i];
     }
+    return NULL;
+}
 
-    if (strncmp(buf, "GET", 3) == 0)
-        r->type = GET;
-    else if (strncmp(buf, "PUT", 3) == 0)
-        r->type = PUT;
-    else if (strncmp(buf, "POST", 4) == 0)
-        r->type = POST;
-    else if (strncmp(buf, "DELETE", 6) == 0)
-        r->type = DELETE;
+JSONObject* request_params(Request* r)
+{
+    if (r->params_json != NULL)
+        return r->params_json;
+    r->params_json = POOL_ALLOCATE(JSONObject);
+    init_table(r->params_json);
+    const StringSlice* values = path_params(r);
+    for (int i = 0; i < r->path_param_count; i++) {
+        //TODO: use json_set when it gets implemented
+        DataValue val;
+        val.type = TYPE_STRING;
+        val.data = (void*)copy_chars(values[i].chars, values[i].len);
+        table_set(r->params_json, copy_string(r->path_param_names[i]), val);
+    }
+    return r->params_json;
 }
 
-static void parse_uri(Request* r, String* line)
+StringSlice* request_reserve_params(Request* r, int count)
 {
-    int start = 0, i;
-    switch (r->type) {
-    case GET:
-        start = 4;
+    if (r->params_json != NULL) {
+        free_json(r->params_json);
+        r->params_json = NULL;
+    }
+    if (r->path_params_spill != NULL)
+        FREE_ARRAY(StringSlice, r->path_params_spill, r->path_params_spill_size);
+    r->path_params_spill = NULL;
+    r->path_params_spill_size = 0;
+    if (count > REQUEST_INLINE_PARAMS) {
+        r->path_params_spill = ALLOCATE(StringSlice, count);
+        r->path_params_spill_size = count;
+    }
+    r->path_param_count = count;
+    return r->path_params_spill != NULL ? r->path_params_spill : r->path_params;
+}
+
+/**
+ * @brief fill the request from the parts the parser has found.
+ * Incomplete requests are filled as far as they were received.
+ * Malformed requests are left empty so they are not routed.
+ *
+ * @param r
+ * @param m message
+ * @param len length of the message
+ * @param p parser that has parsed the message
+ */
+static void build_request(Request* r, const char* m, int len, const RequestParser* p)
+{
+    if (_server_option_verbose_output)
+        printf("FULL MESSAGE:\n%.*s\n", len, m);
+
+    switch (p->state) {
+    case PARSE_ERROR:
         break;
-    case PUT:
-        start = 4;
+    case PARSE_REQUEST_LINE:
+        parse_request_line(r, m + p->line_start, len - p->line_start);
         break;
-    case POST:
-        start = 5;
-        break;
-    case DELETE:
-        start = 7;
+    case PARSE_HEADERS:
+        parse_request_line(r, m + p->request_line_start, p->request_line_len);
+        parse_headers(r, m, p->headers_start, len);
         break;
     default:
+        parse_request_line(r, m + p->request_line_start, p->request_line_len);
+        parse_headers(r, m, p->headers_start, p->content_start);
+        r->content.chars = m + p->content_start;
+        r->content.len = p->body_len;
         break;
     }
 
-    for (i = start; line->chars[i] != ' ' && i < line->len; i++) {
-        STRING_APPEND(&r->uri, line->chars[i]);
+    if (_server_option_verbose_output)
+        print_request(r);
+}
+
+void parse_request_message(Request* r, String* m)
+{
+    RequestParser p;
+    init_request_parser(&p);
+    request_parser_feed(&p, m->chars, m->len);
+    build_request(r, m->chars, m->len, &p);
+}
+
+bool has_buffered_request(Connection* conn)
+{
+    String m = connection_unread(conn);
+    return request_parser_feed(&conn->parser, m.chars, m.len) != PARSE_INCOMPLETE;
+}
+
+/**
+ * @brief build the request from len bytes of the connection buffer,
+ * remove them from the buffer and start parsing the next request
+ *
+ * @param r
+ * @param conn
+ * @param len
+ */
+static void take_request(Request* r, Connection* conn, int len)
+{
+    String m = connection_unread(conn);
+    build_request(r, m.chars, len, &conn->parser);
+    connection_consume(conn, len);
+    init_request_parser(&conn->parser);
+    conn->requests++;
+}
+
+bool parse_buffered_request(Request* r, Connection* conn)
+{
+    String m = connection_unread(conn);
+    switch (request_parser_feed(&conn->parser, m.chars, m.len)) {
+    case PARSE_COMPLETE:
+        // Parse only the first request, the rest of the buffer
+        // belongs to the pipelined requests
+        take_request(r, conn, request_parser_length(&conn->parser));
+        return true;
+    case PARSE_FAILED:
+        // The end of a malformed request can't be found
+        take_request(r, conn, m.len);
+        r->keep_alive = false;
+        return true;
+    default:
+        return false;
     }
+}
 
-    //STRING_APPEND(&r->uri, '\0');
+bool parse_buffered_head(Request* r, Connection* conn)
+{
+    String m = connection_unread(conn);
+    RequestParser* p = &conn->parser;
+    if (request_parser_feed(p, m.chars, m.len) != PARSE_INCOMPLETE
+        || p->head_checked || !request_parser_has_head(p))
+        return false;
+
+    p->head_checked = true;
+    build_request(r, m.chars, m.len, p);
+    return true;
 }
 
-void free_request(Request* r)
+ParseResult buffered_body(Connection* conn, StringSlice* body)
 {
-    STRING_FREE(&r->content);
-    STRING_FREE(&r->uri);
-    if (r->params != NULL)
-        free_json(r->params);
+    String m = connection_unread(conn);
+    ParseResult result = request_parser_feed(&conn->parser, m.chars, m.len);
+    body->chars = m.chars + conn->parser.content_start;
+    body->len = conn->parser.body_len;
+    return result;
 }
 
-void init_request(Request* r)
+bool buffered_body_too_large(const Connection* conn)
 {
-    // Type is -1 by default to indicate possible error
-    r->type = -1;
-    r->params = NULL;
-    STRING_INIT(&r->uri);
-    STRING_INIT(&r->content);
+    return _server_option_max_body_size >= 0
+        && request_parser_body_size(&conn->parser) > _server_option_max_body_size;
 }
 
-void parse_request(Request* r, Connection* conn)
+bool parse_too_large_request(Request* r, Connection* conn)
 {
-    String m, tmp;
-    STRING_INIT(&m);
-    STRING_INIT(&tmp);
-    read_full_request(conn, &m);
-    if (_server_option_verbose_output)
-        printf("FULL MESSAGE:\n%s\n", m.chars);
-    read_line(&m, &tmp, 0);
-    parse_request_type(r, &tmp);
-    parse_uri(r, &tmp);
-    if (r->type == POST)
-        parse_content(r, &m);
-    if (_server_option_verbose_output)
-        print_request(r);
-    STRING_FREE(&m);
-    STRING_FREE(&tmp);
+    if (!buffered_body_too_large(conn))
+        return false;
+    String m = connection_unread(conn);
+    build_request(r, m.chars, m.len, &conn->parser);
+    r->content.chars = NULL;
+    r->content.len = 0;
+    r->keep_alive = false;
+    return true;
+}
+
+void consume_buffered_body(Connection* conn)
+{
+    RequestParser* p = &conn->parser;
+    if (p->state == PARSE_DONE) {
+        connection_consume(conn, request_parser_length(p));
+        init_request_parser(p);
+        conn->requests++;
+        return;
+    }
+
+    String m = connection_unread(conn);
+    connection_truncate(conn, request_parser_discard_body(p, m.chars, m.len));
+}
+
+bool receive_request(Connection* conn, WorkQueue* waiting)
+{
+    // Wait for the next request on a persistent connection
+    // only as long as the idle timeout allows
+    String m = connection_unread(conn);
+    int timeout = REQUEST_READ_TIMEOUT_MS;
+    bool idle = conn->requests > 0 && m.len == 0 && conn->stream == NULL;
+    if (idle)
+        timeout = _server_option_keep_alive_timeout * 1000;
+
+    struct pollfd fd;
+    fd.fd = conn->conn_fd;
+    fd.events = POLLIN;
+    for (;;) {
+        int wait = timeout;
+        if (idle && waiting != NULL && wait > REQUEST_IDLE_CHECK_MS)
+            wait = REQUEST_IDLE_CHECK_MS;
+        int n = poll(&fd, 1, wait);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == 0 && wait < timeout) {
+            // The thread is needed more by a connection with a request
+            if (work_queue_waiting(waiting) > 0)
+                return false;
+            timeout -= wait;
+            continue;
+        }
+        if (n <= 0) // Error in poll or client is too slow
+            return false;
+
+        n = connection_recv(conn);
+        if (n == -1 && errno == EINTR)
+            continue;
+        return n > 0;
+    }
+}
+
+void request_rebase(Request* r, const char* old_base, const char* new_base)
+{
+    for (int i = 0; i < r->header_count; i++) {
+        Header* h = &r->headers[i];
+        h->name.chars = new_base + ((uintptr_t)h->name.chars - (uintptr_t)old_base);
+        h->value.chars = new_base + ((uintptr_t)h->value.chars - (uintptr_t)old_base);
+    }
+}
+
+bool parse_request(Request* r, Connection* conn)
+{
+    // Wait for the next request on a persistent connection
+    // only as long as the idle timeout allows
+    String m = connection_unread(conn);
+    int timeout = REQUEST_READ_TIMEOUT_MS;
+    if (conn->requests > 0 && m.len == 0)
+        timeout = _server_option_keep_alive_timeout * 1000;
+
+    // Incomplete requests are dropped when the client goes silent
+    if (!read_full_request(conn, timeout))
+        return false;
+    return parse_buffered_request(r, conn);
+}
+
+const char* request_type_name(RequestType type)
+{
+    switch (type) {
+    case GET:
+        return "GET";
+    case POST:
+        return "POST";
+    case PUT:
+        return "PUT";
+    case DELETE:
+        return "DELETE";
+    default:
+        return "";
+    }
 }
 
 void print_request(Request* r)
@@ -207,5 +681,5 @@ void print_request(Request* r)
     printf("Request uri_length: %d\n", r->uri.len);
     printf("Request uri: %s\n", r->uri.chars);
     printf("Request content_length: %d\n", r->content.len);
-    printf("Request content: %s\n", r->content.chars);
+    printf("Request content: %.*s\n", r->content.len, r->content.chars);
 }
@@ -1,9 +1,12 @@
 #ifndef REST_REQUEST_H_
 #define REST_REQUEST_H_
 
+#include <time.h>
+
 #include "../datatypes.h"
 #include "../socketcon.h"
 #include "../utils/json.h"
+#include "../utils/queue.h"
 
 typedef enum {
     GET = 1,
@@ -12,22 +15,208 @@ typedef enum {
     DELETE
 } RequestType;
 
+// Amount of RequestType values
+#define REQUEST_TYPE_COUNT 4
+
+// Headers the server uses are looked up once while parsing
+typedef enum {
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONNECTION,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_HOST,
+    HEADER_IF_NONE_MATCH,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_SLOT_COUNT
+} HeaderSlot;
+
 typedef struct {
+    StringSlice name;
+    StringSlice value;
+} Header;
+
+// Headers past this are ignored
+#define REQUEST_MAX_HEADERS 64
+
+// Routes with more parameters keep them in an allocated array
+#define REQUEST_INLINE_PARAMS 8
+
+typedef struct Request {
     RequestType type;
+    // Path of the request line without the query string
     String uri;
-    String content;
-    JSONObject* params;
+    // Query string after the ?, still percent-encoded.
+    // Points to the chars of uri past its terminating null
+    StringSlice query;
+    // Body of any method with Content-Length or chunked encoding.
+    // Like the headers it points to the receive buffer of the
+    // connection, is valid while the request is handled and is not
+    // null terminated
+    StringSlice content;
+    // Values of the :param segments of the route, written by the router
+    // while matching. They point to uri. Use request_param to find one
+    StringSlice path_params[REQUEST_INLINE_PARAMS];
+    // Values of routes with more than REQUEST_INLINE_PARAMS parameters
+    StringSlice* path_params_spill;
+    // Allocated size of path_params_spill
+    int path_params_spill_size;
+    // Names of the values in order, the keywords of the route
+    String** path_param_names;
+    int path_param_count;
+    // Parameters as a JSON object, NULL until request_params builds it.
+    // Renamed from params, which was filled for every request, so
+    // callbacks reading it fail to build. Use request_params instead
+    JSONObject* params_json;
+    // Headers point to the receive buffer of the connection
+    // and are valid while the request is handled
+    Header headers[REQUEST_MAX_HEADERS];
+    int header_count;
+    // Index of the header in headers or -1 if not sent
+    int header_slots[HEADER_SLOT_COUNT];
+    // Client wants to send more requests on the same connection
+    bool keep_alive;
+    // Request line has HTTP/1.1, so chunked responses can be sent
+    bool http11;
+    // If-Modified-Since as time or -1 if not sent
+    time_t if_modified_since;
+    // Accept-Encoding allows gzip
+    bool accept_gzip;
+    // Free for the callbacks, e.g. to keep the state of a streamed upload
+    void* user_data;
 } Request;
 
 // Struct used for callback functions
 typedef struct
 {
-    Connection conn;
+    // Connection the response is sent to
+    Connection* conn;
+    // Connection stays open after the response.
+    // Responses without Content-Length clear this.
+    bool keep_alive;
+    // Complete responses are collected here and sent together
+    // with the responses of the pipelined requests. NULL sends right away
+    String* out;
+    // Headers added with response_add_header
+    String headers;
+    // Request this is the response to
+    Request* request;
+    // Body written with response_write waits here until it fills a chunk
+    String body;
+    // response_begin was called and response_end wasn't
+    bool streaming;
+    // Body is sent with Transfer-Encoding: chunked instead of
+    // being framed by closing the connection
+    bool chunked;
 } Response;
 
-void parse_request(Request* r, Connection* conn);
+/*
+* Read and parse the next request from the connection.
+* Returns false if the client closed the connection or didn't send
+* a complete request in time
+*/
+bool parse_request(Request* r, Connection* conn);
+/*
+* Wait for more data and receive it to the connection buffer.
+* Returns false if the client closed the connection or sent nothing in time.
+* An idle persistent connection is also given up once connections are
+* waiting in the waiting queue, so idle clients can't hold every worker.
+* NULL waits for the whole keep-alive timeout
+*/
+bool receive_request(Connection* conn, WorkQueue* waiting);
+/*
+* True if the connection buffer holds a complete or a malformed request.
+* Parsing continues from where the previous call stopped
+*/
+bool has_buffered_request(Connection* conn);
+/*
+* Parse the first complete request from the connection buffer and remove it
+* from the buffer. Returns false if the buffer doesn't hold a complete request
+*/
+bool parse_buffered_request(Request* r, Connection* conn);
+/*
+* Parse the request line and the headers of an incomplete request in the
+* connection buffer. Returns true only once for each request
+*/
+bool parse_buffered_head(Request* r, Connection* conn);
+/*
+* Set body to the part of the body that is received and not consumed yet.
+* Returns PARSE_COMPLETE when the last part has been received
+*/
+ParseResult buffered_body(Connection* conn, StringSlice* body);
+/*
+* True if the body of the request in the connection buffer is larger
+* than set_server_option_max_body_size allows
+*/
+bool buffered_body_too_large(const Connection* conn);
+/*
+* Parse the head of the incomplete request in the connection buffer if
+* its body is too large. The request has no content and the connection
+* can't be kept alive since the rest of the body is not read
+*/
+bool parse_too_large_request(Request* r, Connection* conn);
+/*
+* Remove the body returned by buffered_body from the connection buffer.
+* The complete request is removed when its last part is consumed
+*/
+void consume_buffered_body(Connection* conn);
+/*
+* Parse a request from message that is already read from the connection.
+* Chunked bodies are decoded in place and the request points to m
+*/
+void parse_request_message(Request* r, String* m);
+/*
+* Value of the header with case insensitive name or NULL if not sent
+*/
+const StringSlice* request_header(const Request* r, const char* name);
+/*
+* Value of a common header or NULL if not sent
+*/
+const StringSlice* request_header_slot(const Request* r, HeaderSlot slot);
+// Walks the name=value pairs of a query string
+typedef struct {
+    const char* pos;
+    const char* end;
+} QueryIterator;
+
+void request_query_iterator(const Request* r, QueryIterator* it);
+/*
+* Next pair of the query string, still percent-encoded.
+* Pairs without = have an empty value. Returns false after the last pair
+*/
+bool query_next(QueryIterator* it, StringSlice* name, StringSlice* value);
+/*
+* Decode %XX escapes and + of a query string part to out.
+* Returns the decoded length or -1 if it doesn't fit to out_size
+* with the terminating null
+*/
+int url_decode(const char* s, int len, char* out, int out_size);
+/*
+* Find the first query parameter with the name and decode its value
+* to buf. Returns the decoded length or -1 if the parameter was not sent
+* or doesn't fit to buf
+*/
+int request_query(const Request* r, const char* name, char* buf, int buf_size);
+/*
+* Value of the :name segment of the route or NULL
+*/
+const StringSlice* request_param(const Request* r, const char* name);
+/*
+* Parameters of the route as a JSON object of strings.
+* Built on the first call and freed with the request
+*/
+JSONObject* request_params(Request* r);
+/*
+* Make room for the values of count parameters, dropping the previous
+* ones. Values already in the inline array are kept
+*/
+StringSlice* request_reserve_params(Request* r, int count);
+/*
+* Move the header slices after the message has moved from old_base to new_base
+*/
+void request_rebase(Request* r, const char* old_base, const char* new_base);
 void init_request(Request* r);
 void free_request(Request* r);
+// Method name as in the request line
+const char* request_type_name(RequestType type);
 void print_request(Request* r);
 
 #endif
@@ -0,0 +1,177 @@
+#include <string.h>
+
+#include "router.h"
+#include "utils/memory.h"
+
+struct RouteNode {
+    // Static part of the url matched by this node.
+    // Empty for the nodes matching a parameter
+    char* prefix;
+    int prefix_len;
+    // Static children. Their prefixes start with different characters
+    // which are kept in firsts to find the child with one memchr
+    RouteNode** children;
+    char* firsts;
+    int child_count;
+    // Child matching one parameter segment
+    RouteNode* param;
+    // Value of the pattern ending here or NULL
+    void* value;
+};
+
+static RouteNode* new_node(const char* prefix, int len)
+{
+    RouteNode* node = ALLOCATE(RouteNode, 1);
+    node->prefix = NULL;
+    node->prefix_len = len;
+    if (len > 0) {
+        node->prefix = ALLOCATE(char, len);
+        memcpy(node->prefix, prefix, len);
+    }
+    node->children = NULL;
+    node->firsts = NULL;
+    node->child_count = 0;
+    node->param = NULL;
+    node->value = NULL;
+    return node;
+}
+
+static void free_node(RouteNode* node)
+{
+    if (node == NULL)
+        return;
+    for (int i = 0; i < node->child_count; i++)
+        free_node(node->children[i]);
+    free_node(node->param);
+    FREE_ARRAY(RouteNode*, node->children, node->child_count);
+    FREE_ARRAY(char, node->firsts, node->child_count);
+    FREE_ARRAY(char, node->prefix, node->prefix_len);
+    FREE(RouteNode, node);
+}
+
+static int find_child(const RouteNode* node, char c)
+{
+    if (node->child_count == 0)
+        return -1;
+    const char* found = memchr(node->firsts, c, node->child_count);
+    return found != NULL ? (int)(found - node->firsts) : -1;
+}
+
+static void add_child(RouteNode* node, RouteNode* child)
+{
+    node->children = GROW_ARRAY(node->children, RouteNode*, node->child_count, node->child_count + 1);
+    node->firsts = GROW_ARRAY(node->firsts, char, node->child_count, node->child_count + 1);
+    node->children[node->child_count] = child;
+    node->firsts[node->child_count] = child->prefix[0];
+    node->child_count++;
+}
+
+static bool is_param_start(const char* pattern, int pos)
+{
+    return pattern[pos] == ':' && (pos == 0 || pattern[pos - 1] == '/');
+}
+
+void init_router(Router* router)
+{
+    router->root = new_node(NULL, 0);
+    router->count = 0;
+}
+
+void free_router(Router* router)
+{
+    free_node(router->root);
+    router->root = NULL;
+    router->count = 0;
+}
+
+void* router_add(Router* router, const char* pattern, void* value)
+{
+    RouteNode* node = router->root;
+    int len = (int)strlen(pattern);
+    int pos = 0;
+    while (pos < len) {
+        if (is_param_start(pattern, pos)) {
+            // Names of the parameters are not part of the tree
+            while (pos < len && pattern[pos] != '/')
+                pos++;
+            if (node->param == NULL)
+                node->param = new_node(NULL, 0);
+            node = node->param;
+            continue;
+        }
+
+        int end = pos + 1;
+        while (end < len && !is_param_start(pattern, end))
+            end++;
+        int i = find_child(node, pattern[pos]);
+        if (i < 0) {
+            RouteNode* child = new_node(pattern + pos, end - pos);
+            add_child(node, child);
+            node = child;
+            pos = end;
+            continue;
+        }
+
+        RouteNode* child = node->children[i];
+        int common = 0;
+        while (common < child->prefix_len && pos + common < end
+            && child->prefix[common] == pattern[pos + common])
+            common++;
+        // Split the child where the pattern leaves its prefix
+        if (common < child->prefix_len) {
+            RouteNode* split = new_node(child->prefix, common);
+            memmove(child->prefix, child->prefix + common, child->prefix_len - common);
+            child->prefix_len -= common;
+            add_child(split, child);
+            node->children[i] = split;
+            child = split;
+        }
+        node = child;
+        pos += common;
+    }
+
+    void* previous = node->value;
+    if (previous == NULL)
+        router->count++;
+    node->value = value;
+    return previous;
+}
+
+static void* match_node(const RouteNode* node, const char* url, int pos, int len,
+    StringSlice* params, int param, int max_params)
+{
+    if (node->prefix_len > 0) {
+        if (node->prefix_len > len - pos || memcmp(node->prefix, url + pos, node->prefix_len) != 0)
+            return NULL;
+        pos += node->prefix_len;
+    }
+    if (pos == len)
+        return node->value;
+
+    // Static segments are tried first and the parameter if they don't match
+    int i = find_child(node, url[pos]);
+    if (i >= 0) {
+        void* value = match_node(node->children[i], url, pos, len, params, param, max_params);
+        if (value != NULL)
+            return value;
+    }
+    if (node->param == NULL)
+        return NULL;
+    const char* slash = memchr(url + pos, '/', len - pos);
+    int end = slash != NULL ? (int)(slash - url) : len;
+    if (end == pos)
+        return NULL;
+    // A later backtrack overwrites the values of a failed branch
+    if (params != NULL && param < max_params) {
+        params[param].chars = url + pos;
+        params[param].len = end - pos;
+    }
+    return match_node(node->param, url, end, len, params, param + 1, max_params);
+}
+
+void* router_match(const Router* router, const char* url, int len, StringSlice* params, int max_params)
+{
+    if (router->count == 0)
+        return NULL;
+    return match_node(router->root, url, 0, len, params, 0, max_params);
+}
@@ -0,0 +1,38 @@
+#ifndef REST_ROUTER_H_
+#define REST_ROUTER_H_
+
+#include <stdbool.h>
+
+#include "datatypes.h"
+
+typedef struct RouteNode RouteNode;
+
+/*
+* Compressed radix tree of url patterns. Segments starting with : match
+* any non-empty segment. Static segments are tried before parameters so
+* "/user/me" wins over "/user/:id" whatever order they were added in.
+* The tree is built while the urls are added and only read afterwards,
+* so matching needs no locking.
+*/
+typedef struct {
+    RouteNode* root;
+    // Amount of added patterns
+    int count;
+} Router;
+
+void init_router(Router* router);
+void free_router(Router* router);
+/*
+* Add the pattern, e.g. "/user/:id/posts". Adding the same pattern
+* again replaces the value. Returns the replaced value or NULL
+*/
+void* router_add(Router* router, const char* pattern, void* value);
+/*
+* Match the url without allocating. The values of the first max_params
+* parameters are written to params in the order of the pattern and point
+* to url. params can be NULL.
+* Returns the value of the pattern or NULL if nothing matches
+*/
+void* router_match(const Router* router, const char* url, int len, StringSlice* params, int max_params);
+
+#endif
@@ -70,14 +70,35 @@
 
 #include <pthread.h>
 
+#include "eventloop.h"
 #include "http.h"
 #include "options.h"
 #include "requests/request.h"
 #include "server.h"
+#include "utils/queue.h"
 
 RestServer __rs;
 volatile int _server_option_verbose_output = 0;
 volatile unsigned short _server_option_tcp_port = 8888;
+// 0 handles connections with the worker threads
+volatile int _server_option_event_loop_threads = 0;
+volatile int _server_option_worker_threads = 16;
+volatile int _server_option_worker_queue_size = 1024;
+// Seconds a persistent connection can stay idle
+volatile int _server_option_keep_alive_timeout = 5;
+volatile int _server_option_keep_alive_max_requests = 100;
+// Amount of static files kept open
+volatile int _server_option_file_cache_size = 64;
+// Largest cached file that is also kept in memory, -1 disables
+volatile long _server_option_file_cache_memory = -1;
+// Smallest JSON body that is compressed, -1 disables
+volatile int _server_option_gzip_json_min_size = -1;
+// First block of the per-thread request arena, 0 disables
+volatile int _server_option_request_arena_size = 0;
+// Largest body buffered for a callback, -1 disables the limit
+volatile long _server_option_max_body_size = 8 * 1024 * 1024;
+// Thread allocator of the server threads, NULL uses the default allocator
+const Allocator* volatile _server_option_allocator = NULL;
 
 void set_server_option_verbose_output()
 {
@@ -89,19 +110,51 @@ void set_server_option_tcp_port_number(unsigned short port)
     _server_option_tcp_port = port;
 }
 
-typedef struct
+void set_server_option_worker_threads(int threads, int queue_size)
 {
-    ApiUrl* urls;
-    int urls_len;
-    JSONObject* suburls;
-} ApiTable;
+    _server_option_worker_threads = threads;
+    _server_option_worker_queue_size = queue_size;
+}
+
+void set_server_option_keep_alive(int timeout, int max_requests)
+{
+    _server_option_keep_alive_timeout = timeout;
+    _server_option_keep_alive_max_requests = max_requests;
+}
+
+void set_server_option_file_cache_size(int files)
+{
+    _server_option_file_cache_size = files;
+}
+
+void set_server_option_file_cache_memory(long max_file_size)
+{
+    _server_option_file_cache_memory = max_file_size;
+}
+
+void set_server_option_gzip_json(int min_size)
+{
+    _server_option_gzip_json_min_size = min_size;
+}
 
-static void init_apitable(ApiTable* at)
+void set_server_option_request_arena(int block_size)
 {
-    at->urls = NULL;
-    at->urls_len = 0;
-    at->suburls = ALLOCATE(JSONObject, 1);
-    init_table(at->suburls);
+    _server_option_request_arena_size = block_size;
+}
+
+void set_server_option_max_body_size(long max_size)
+{
+    _server_option_max_body_size = max_size;
+}
+
+void set_server_option_allocator(const Allocator* allocator)
+{
+    _server_option_allocator = allocator;
+}
+
+void set_server_option_event_loop_threads(int threads)
+{
+    _server_option_event_loop_threads = threads;
 }
 
 static String** parse_keywords(char* endpoint, int* length)
@@ -111,7 +164,8 @@ static String** parse_keywords(char* endpoint, int* length)
     int len = 0;
     int i, j;
     for (i = 0; i < e_len; i++) {
-        if (endpoint[i] == ':') {
+        // Parameters start a segment like in the router
+        if (endpoint[i] == ':' && (i == 0 || endpoint[i - 1] == '/')) {
             // "Consume" the : character
             i++;
             len = 0;
@@ -120,7 +174,7 @@ static String** parse_keywords(char* endpoint, int* length)
                     break;
                 len++;
             }
-            kws = GROW_ARRAY(kws, String*, 0, *length + 1);
+            kws = GROW_ARRAY(kws, String*, *length, *length + 1);
             kws[*length] = copy_chars(endpoint + i, len);
             *length = *length + 1;
             i += len;
@@ -129,19 +183,6 @@ static String** parse_keywords(char* endpoint, int* length)
     return kws;
 }
 
-static DataValue create_api_data(char* endpoint, RestCallback cb)
-{
-    ApiUrl* au = ALLOCATE(ApiUrl, 1);
-    au->callback = cb;
-    au->kw_len = 0;
-    au->keywords = parse_keywords(endpoint, &au->kw_len);
-
-    DataValue val;
-    val.type = TYPE_API_FUNCTION;
-    val.data = (void*)au;
-    return val;
-}
-
 static String* endpoint_key(const char* uri, int len)
 {
     int i;
@@ -196,12 +237,45 @@ static String* get_endpoint_url(RestServer* rs, String* url)
     return NULL;
 }
 
+static WorkQueue accepted_clients;
+
+static void* worker_thread(void* arg)
+{
+    memory_use_thread_allocator(_server_option_allocator);
+    for (;;) {
+        int connectfd = work_queue_pop(&accepted_clients);
+        accept_client(connectfd, &accepted_clients);
+    }
+
+    return NULL;
+}
+
+static void start_workers()
+{
+    int threads = _server_option_worker_threads;
+    if (threads < 1)
+        threads = 1;
+
+    init_work_queue(&accepted_clients, _server_option_worker_queue_size);
+    for (int i = 0; i < threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_thread, NULL) != 0) {
+            perror("thread failed");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(thread);
+    }
+}
+
 void init_server(RestServer* rss)
 {
     rss->clients = NULL;
     rss->endpoints = NULL;
     rss->endpoint_len = 0;
-    init_table(&rss->urls);
+    rss->streaming_urls = 0;
+    init_router(&rss->urls);
+    for (int i = 0; i < REQUEST_TYPE_COUNT; i++)
+        init_router(&rss->method_urls[i]);
 }
 
 void free_server(RestServer* rss)
@@ -211,156 +285,118 @@ void free_server(RestServer* rss)
     }
 }
 
-void parse_paramas(Request* r, ApiUrl* au)
-{
-    if (au->kw_len == 0)
-        return;
-    int pos = r->uri.len - 1;
-    int i, j, len;
-    r->params = ALLOCATE(JSONObject, 1);
-    init_table(r->params);
-    for (i = au->kw_len - 1; i >= 0; i--) {
-        len = 0;
-        for (j = pos; j >= 0; j--) {
-            if (r->uri.chars[j] == '/')
-                break;
-            len++;
-        }
-        //TODO: use json_set when it gets implemented
-        DataValue val;
-        val.type = TYPE_STRING;
-        val.data = (void*)copy_chars(r->uri.chars + j + 1, len);
-        table_set(r->params, copy_string(au->keywords[i]), val);
-        pos = j - 1;
-    }
+/**
+ * @brief match the url with the router. The values of the :params are
+ * written to r while matching
+ *
+ * @param urls
+ * @param url
+ * @param r gets the path parameters of the route, can be NULL
+ * @return ApiUrl* or NULL if nothing matches
+ */
+static ApiUrl* match_route(const Router* urls, const String* url, Request* r)
+{
+    if (r == NULL)
+        return router_match(urls, url->chars, url->len, NULL, 0);
+    ApiUrl* au = router_match(urls, url->chars, url->len, r->path_params, REQUEST_INLINE_PARAMS);
+    if (au == NULL)
+        return NULL;
+    StringSlice* values = request_reserve_params(r, au->kw_len);
+    // Values past the inline array need the allocated one first
+    if (au->kw_len > REQUEST_INLINE_PARAMS)
+        router_match(urls, url->chars, url->len, values, au->kw_len);
+    r->path_param_names = au->keywords;
+    return au;
 }
 
-static String** split_url(char* endpoint, int* amount)
+static ApiUrl* find_route(RestServer* rs, RequestType type, String* url, unsigned* allowed_methods, Request* r)
 {
-    String** val = NULL;
-    int pos = 0;
-    int len = 1;
-    int endpoint_len = (int)strlen(endpoint);
-    for (int i = 1; i < endpoint_len; i++) {
-        if (endpoint[i] == '/') {
-            String* tmp = copy_chars(endpoint + pos, len);
-            pos = len + pos;
-            len = 0;
-            val = GROW_ARRAY(val, String*, 0, *amount + 1);
-            val[*amount] = tmp;
-            *amount += 1;
-            if (endpoint[i + 1] == ':')
-                return val;
-        }
-        len++;
+    *allowed_methods = 0;
+    if (r != NULL)
+        request_reserve_params(r, 0);
+    ApiUrl* au = NULL;
+    if (type >= GET && type <= DELETE)
+        au = match_route(&rs->method_urls[type - GET], url, r);
+    if (au == NULL)
+        au = match_route(&rs->urls, url, r);
+    if (au != NULL)
+        return au;
+
+    for (int i = 0; i < REQUEST_TYPE_COUNT; i++) {
+        if (router_match(&rs->method_urls[i], url->chars, url->len, NULL, 0) != NULL)
+            *allowed_methods |= 1u << (GET + i);
     }
-    String* tmp = copy_chars(endpoint + pos, len);
-    val = GROW_ARRAY(val, String*, 0, *amount + 1);
-    val[*amount] = tmp;
-    *amount += 1;
-
-    return val;
+    return NULL;
 }
 
 ApiUrl* get_call_back(RestServer* rs, String* url)
 {
-    int len = 0;
-    String** splits = split_url(url->chars, &len);
-    Table* tmp_table = &rs->urls;
-    ApiUrl* return_url = NULL;
-    DataValue val;
-    bool found = table_get(tmp_table, splits[0], &val);
-    if (!found || val.data == NULL)
-        goto end;
-    ApiTable* at = (ApiTable*)val.data;
-    for (int i = 0; i < len; i++) {
-        if (i == len - 1) {
-            if (at->urls[0].kw_len == 0)
-                return_url = &at->urls[0];
-        } else {
-            if (at->suburls != NULL && at->suburls->count != 0) {
-                // Test if there is a table for following keyword
-                bool found = table_get(at->suburls, splits[i + 1], &val);
-                if (found && val.data != NULL) {
-                    at = (ApiTable*)val.data;
-                    tmp_table = at->suburls;
-                    continue;
-                }
-                // else try to find the callback apiurl
-                for (int j = 0; j < at->urls_len; j++) {
-                    if (at->urls[j].kw_len == (len - (i + 1))) {
-                        return_url = &at->urls[j];
-                    }
-                }
-                goto end;
-            } else {
-                for (int j = 0; j < at->urls_len; j++) {
-                    if (at->urls[j].kw_len == (len - (i + 1))) {
-                        return_url = &at->urls[j];
-                    }
-                }
-                goto end;
-            }
-        }
-    }
+    return router_match(&rs->urls, url->chars, url->len, NULL, 0);
+}
 
-end:
-    for (int i = 0; i < len; i++) {
-        STRINGP_FREE(splits[i]);
-    }
-    free(splits);
-    return return_url;
+ApiUrl* get_method_call_back(RestServer* rs, RequestType type, String* url, unsigned* allowed_methods)
+{
+    return find_route(rs, type, url, allowed_methods, NULL);
 }
 
-void add_url(RestServer* rs, char* endpoint, RestCallback cb)
+ApiUrl* get_request_call_back(RestServer* rs, Request* r, unsigned* allowed_methods)
+{
+    return find_route(rs, r->type, &r->uri, allowed_methods, r);
+}
+
+static void free_api_url(ApiUrl* au)
+{
+    STRINGP_FREE(au->endpoint);
+    for (int i = 0; i < au->kw_len; i++)
+        STRINGP_FREE(au->keywords[i]);
+    FREE_ARRAY(String*, au->keywords, au->kw_len);
+    FREE(ApiUrl, au);
+}
+
+static void add_route(Router* urls, char* endpoint, RestCallback cb, RestBodyCallback body_cb)
 {
     //TODO: throw an error and close program if endpoint doesn't start with /
-    //TODO: throw an error if the endpoint already exists;
+    ApiUrl* au = ALLOCATE(ApiUrl, 1);
+    au->endpoint = copy_chars(endpoint, (int)strlen(endpoint));
+    au->kw_len = 0;
+    au->keywords = parse_keywords(endpoint, &au->kw_len);
+    au->callback = cb;
+    au->body_callback = body_cb;
+    // Same endpoint again replaces the previous callback
+    ApiUrl* previous = router_add(urls, endpoint, au);
+    if (previous != NULL)
+        free_api_url(previous);
+}
 
-    int len = 0;
-    String** splits = split_url(endpoint, &len);
-    Table* tmp_table = &rs->urls;
-    for (int i = 0; i < len; i++) {
-        if (i == len - 1) {
-            DataValue val;
-            bool found = table_get(tmp_table, splits[i], &val);
-            if (!found || val.data == NULL) {
-                ApiTable* at = ALLOCATE(ApiTable, 1);
-                init_apitable(at);
-                at->urls = ALLOCATE(ApiUrl, 1);
-                at->urls->kw_len = 0;
-                at->urls->keywords = parse_keywords(endpoint, &at->urls->kw_len);
-                at->urls->callback = cb;
-                at->urls_len++;
-                DataValue d_val;
-                d_val.type = TYPE_API_FUNCTION;
-                d_val.data = (void*)at;
-                table_set(tmp_table, splits[i], d_val);
-            } else {
-                ApiTable* at = (ApiTable*)val.data;
-                at->urls = GROW_ARRAY(at->urls, ApiUrl, 0, at->urls_len + 1);
-                at->urls[at->urls_len].kw_len = 0;
-                at->urls[at->urls_len].keywords = parse_keywords(endpoint, &at->urls[at->urls_len].kw_len);
-                at->urls[at->urls_len].callback = cb;
-                at->urls_len++;
-            }
-            //table_set(tmp_table, splits[i], create_api_data(endpoint, cb));
-        } else {
-            DataValue val;
-            bool found = table_get(tmp_table, splits[i], &val);
-            if (!found || val.data == NULL) {
-                ApiTable* at = ALLOCATE(ApiTable, 1);
-                init_apitable(at);
-                DataValue d_val;
-                d_val.type = TYPE_API_FUNCTION;
-                d_val.data = (void*)at;
-                table_set(tmp_table, splits[i], d_val);
-                tmp_table = at->suburls;
-            } else {
-                tmp_table = ((ApiTable*)val.data)->suburls;
-            }
-        }
-    }
+void add_url(RestServer* rs, char* endpoint, RestCallback cb)
+{
+    add_route(&rs->urls, endpoint, cb, NULL);
+}
+
+void add_get(RestServer* rs, char* endpoint, RestCallback cb)
+{
+    add_route(&rs->method_urls[GET - GET], endpoint, cb, NULL);
+}
+
+void add_post(RestServer* rs, char* endpoint, RestCallback cb)
+{
+    add_route(&rs->method_urls[POST - GET], endpoint, cb, NULL);
+}
+
+void add_put(RestServer* rs, char* endpoint, RestCallback cb)
+{
+    add_route(&rs->method_urls[PUT - GET], endpoint, cb, NULL);
+}
+
+void add_delete(RestServer* rs, char* endpoint, RestCallback cb)
+{
+    add_route(&rs->method_urls[DELETE - GET], endpoint, cb, NULL);
+}
+
+void add_url_streaming(RestServer* rs, char* endpoint, RestCallback cb, RestBodyCallback body_cb)
+{
+    add_route(&rs->urls, endpoint, cb, body_cb);
+    rs->streaming_urls++;
 }
 
 int run_server(RestServer* rs)
@@ -376,8 +412,6 @@ int run_server(RestServer* rs)
     // which is exacly what uint16_t holds
     uint16_t port = _server_option_tcp_port;
 
-    pthread_t thread;
-
     struct sockaddr_in sa;
 
     // Set ipv4 tcp socket with stream socket
@@ -412,14 +446,21 @@ int run_server(RestServer* rs)
     }
 
     // Prepare to accept connections on socket FD.
-    // This tries 10 times if connection is working and returns -1
-    // if there is a problem
-    if (listen(socketfd, 10) == -1) {
+    // Connections wait in the backlog while the workers are busy
+    if (listen(socketfd, SOMAXCONN) == -1) {
         perror("listen failed");
         close(socketfd);
         exit(EXIT_FAILURE);
     }
 
+    if (_server_option_event_loop_threads > 0) {
+        int ret = run_event_loop(socketfd, _server_option_event_loop_threads);
+        close(socketfd);
+        return ret;
+    }
+
+    start_workers();
+
     // Tcp connection loop
     for (;;) {
         // Wait for new connection and set the file descriptor for it
@@ -433,11 +474,10 @@ int run_server(RestServer* rs)
             exit(EXIT_FAILURE);
         }
 
-        // Handle each connection in a thread
-        if (pthread_create(&thread, NULL, accept_client, &connectfd) != 0) {
-            perror("thread failed");
-            close(connectfd);
-        }
+        // Hand the connection to a worker. When all the workers are busy
+        // and the queue is full this blocks, leaving new connections
+        // waiting in the listen backlog.
+        work_queue_push(&accepted_clients, connectfd);
     }
 
     close(socketfd);
@@ -2,35 +2,136 @@
 #define REST_SERVER_H_
 
 #include "requests/request.h"
+#include "router.h"
 #include "utils/hashtable.h"
 
 typedef void (*RestCallback)(Response* resp, Request* test);
+/*
+* Receives the body of a streamed request part by part as it arrives.
+* The part is freed after the call so the whole body is never kept in
+* memory. Returning false refuses the rest of the body and closes the
+* connection. A part with NULL chars means the client went away before
+* the body was complete and the callback won't be called again.
+*/
+typedef bool (*RestBodyCallback)(Request* req, StringSlice part);
 
-//TODO: own tables for each request type POST GET PUT etc.
 typedef struct {
     int* clients;
-    Table urls;
+    // Urls added with add_url match every method
+    Router urls;
+    // Urls added with add_get, add_post etc. by RequestType - 1
+    Router method_urls[REQUEST_TYPE_COUNT];
     String** endpoints;
     int endpoint_len;
+    // Amount of urls added with add_url_streaming
+    int streaming_urls;
 } RestServer;
 
 extern RestServer __rs;
 
 typedef struct
 {
+    // Endpoint the url was added with
+    String* endpoint;
     String** keywords; // Contains the /:id/:name etc keywords in order
     int kw_len;
     RestCallback callback;
+    // NULL unless the url was added with add_url_streaming
+    RestBodyCallback body_callback;
 } ApiUrl;
 
-void parse_paramas(Request* r, ApiUrl* au);
 ApiUrl* get_call_back(RestServer* rs, String* endpoint);
+/*
+* Find the callback of the method. Urls of the method are matched before
+* the urls added with add_url. If nothing matches, allowed_methods gets
+* the methods with a matching url as bits 1 << RequestType
+*/
+ApiUrl* get_method_call_back(RestServer* rs, RequestType type, String* endpoint, unsigned* allowed_methods);
+/*
+* Find the callback of the method and uri of r like get_method_call_back.
+* The router points the path parameters of r to the uri segments matched
+* by the :params of the route. Allocates only for routes with more than
+* REQUEST_INLINE_PARAMS parameters
+*/
+ApiUrl* get_request_call_back(RestServer* rs, Request* r, unsigned* allowed_methods);
 void add_url(RestServer* rs, char* endpoint, RestCallback cb);
+/*
+* Add a url for one method only. Other methods of the url get
+* 405 Method Not Allowed unless the url is added with add_url too
+*/
+void add_get(RestServer* rs, char* endpoint, RestCallback cb);
+void add_post(RestServer* rs, char* endpoint, RestCallback cb);
+void add_put(RestServer* rs, char* endpoint, RestCallback cb);
+void add_delete(RestServer* rs, char* endpoint, RestCallback cb);
+/*
+* Like add_url but the request body is passed to body_cb while it is
+* received and cb gets the request without content once the body is
+* complete. Reading the socket waits for body_cb so slow callbacks slow
+* down the client instead of filling the memory.
+* Request.user_data can hold the state of the upload between the calls.
+*/
+void add_url_streaming(RestServer* rs, char* endpoint, RestCallback cb, RestBodyCallback body_cb);
 void init_server(RestServer* rs);
 int run_server(RestServer* rs);
 void free_server(RestServer* rs);
 
 void set_server_option_verbose_output();
 void set_server_option_tcp_port_number(unsigned short port);
+/*
+* Handle the connections with a fixed amount of worker threads.
+* Accepting new connections waits when queue_size connections are already
+* waiting for a free worker.
+*/
+void set_server_option_worker_threads(int threads, int queue_size);
+/*
+* Keep HTTP/1.1 connections open for more requests. Idle connections are
+* closed after timeout seconds and every connection after max_requests.
+* max_requests 1 closes every connection after the first response.
+*/
+void set_server_option_keep_alive(int timeout, int max_requests);
+/*
+* Keep the file descriptors and stat results of the most recently
+* sent static files open. Up to as many missing paths are remembered
+* separately, so requests for them don't push out the open files.
+* 0 opens the file for every request
+*/
+void set_server_option_file_cache_size(int files);
+/*
+* Keep cached files up to max_file_size bytes in memory together with
+* their response headers so they are sent without touching the file system
+*/
+void set_server_option_file_cache_memory(long max_file_size);
+/*
+* Compress JSON bodies of at least min_size bytes with gzip
+* if the client accepts it. -1 disables the compression
+*/
+void set_server_option_gzip_json(int min_size);
+/*
+* Allocate the memory used while a callback runs and its response is
+* sent from an arena of block_size bytes that is emptied after the
+* response. Objects made with the library functions, like JSON and
+* Strings, must not be kept after the callback returns. 0 disables
+*/
+void set_server_option_request_arena(int block_size);
+/*
+* Refuse requests with a body of more than max_size bytes with
+* 413 Payload Too Large before the body is received. Streamed bodies
+* are not limited. 8 MiB by default, -1 disables
+*/
+void set_server_option_max_body_size(long max_size);
+/*
+* Allocate the memory of the server threads with allocator instead of
+* the default allocator. The allocator is shared by all the server
+* threads, so it must be thread safe, and it must have owns so memory
+* from elsewhere is freed by the default allocator. Allocators without
+* owns are ignored. The request arena is still used for the requests
+* if it's enabled
+*/
+void set_server_option_allocator(const Allocator* allocator);
+/*
+* Multiplex all the connections with epoll in the given amount of threads
+* instead of creating a thread for every connection
+*/
+void set_server_option_event_loop_threads(int threads);
 
 #endif
@@ -0,0 +1,347 @@
+/**
+ * <sys/socket.h>
+ *
+ * functions:
+ * recv()
+ */
+#include <sys/socket.h>
+
+/**
+ * <unistd.h>
+ *
+ * functions:
+ * close()
+ */
+#include <unistd.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/sendfile.h>
+
+#include "socketcon.h"
+#include "utils/memory.h"
+
+// Minimum free space in the buffer before each recv
+#define CONNECTION_READ_SIZE 8192
+// How long a client can block the response before we give up
+#define SEND_TIMEOUT_MS 5000
+
+void init_connection(Connection* conn, int conn_fd)
+{
+    conn->conn_fd = conn_fd;
+    conn->is_alive = true;
+    conn->requests = 0;
+    conn->consumed = 0;
+    init_request_parser(&conn->parser);
+    conn->stream = NULL;
+    STRING_INIT(&conn->buffer);
+    STRING_INIT(&conn->out);
+    conn->defer_writes = false;
+    STRING_INIT(&conn->pending);
+    conn->pending_file = -1;
+    conn->pending_offset = 0;
+    conn->pending_count = 0;
+}
+
+int connection_recv(Connection* conn)
+{
+    String* b = &conn->buffer;
+    // Move the unread bytes to the beginning before reading more
+    if (conn->consumed > 0) {
+        memmove(b->chars, b->chars + conn->consumed, b->len - conn->consumed);
+        b->len -= conn->consumed;
+        conn->consumed = 0;
+    }
+    // Keep one byte for the terminating null
+    if (b->capacity - b->len < CONNECTION_READ_SIZE + 1) {
+        int old_capacity = b->capacity;
+        b->capacity = GROW_CAPACITY(old_capacity + CONNECTION_READ_SIZE);
+        b->chars = GROW_ARRAY(b->chars, char, old_capacity, b->capacity);
+    }
+
+    ssize_t n = recv(conn->conn_fd, b->chars + b->len, b->capacity - b->len - 1, 0);
+    if (n > 0) {
+        b->len += n;
+        b->chars[b->len] = '\0';
+    } else if (n == 0) {
+        conn->is_alive = false;
+    }
+
+    return (int)n;
+}
+
+void connection_consume(Connection* conn, int len)
+{
+    // Pipelined requests are consumed one by one so the bytes
+    // are only moved when the next recv needs the space
+    conn->consumed += len;
+    if (conn->consumed >= conn->buffer.len) {
+        conn->consumed = 0;
+        conn->buffer.len = 0;
+    }
+}
+
+void connection_truncate(Connection* conn, int len)
+{
+    conn->buffer.len = conn->consumed + len;
+    if (conn->buffer.chars != NULL)
+        conn->buffer.chars[conn->buffer.len] = '\0';
+}
+
+String connection_unread(Connection* conn)
+{
+    String m;
+    STRING_INIT(&m);
+    if (conn->buffer.chars != NULL)
+        m.chars = conn->buffer.chars + conn->consumed;
+    m.len = conn->buffer.len - conn->consumed;
+    return m;
+}
+
+/**
+ * @brief wait until a non-blocking socket is writable again
+ *
+ * @param fd
+ * @return true if the socket can be written
+ */
+static bool wait_writable(int fd)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    return poll(&pfd, 1, SEND_TIMEOUT_MS) > 0;
+}
+
+/**
+ * @brief send as much of the buffers as the socket takes without waiting.
+ * The iov array of msg is advanced past the sent bytes.
+ *
+ * @param fd
+ * @param msg
+ * @param flags
+ * @return false if the client is gone
+ */
+static bool sendv_some(int fd, struct msghdr* msg, int flags)
+{
+    while (msg->msg_iovlen > 0) {
+        // sendmsg instead of writev so a closed socket doesn't raise SIGPIPE
+        ssize_t n = sendmsg(fd, msg, flags | MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        // Skip the fully sent buffers and advance the partially sent one
+        while (msg->msg_iovlen > 0 && (size_t)n >= msg->msg_iov->iov_len) {
+            n -= msg->msg_iov->iov_len;
+            msg->msg_iov++;
+            msg->msg_iovlen--;
+        }
+        if (msg->msg_iovlen > 0) {
+            msg->msg_iov->iov_base = (char*)msg->msg_iov->iov_base + n;
+            msg->msg_iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief send as much of the file as the socket takes without waiting
+ *
+ * @param fd
+ * @param file_fd
+ * @param offset advanced past the sent bytes
+ * @param count decreased by the sent bytes
+ * @return false if the client is gone or the file got shorter
+ */
+static bool sendfile_some(int fd, int file_fd, off_t* offset, size_t* count)
+{
+    while (*count > 0) {
+        ssize_t n = sendfile(fd, file_fd, offset, *count);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        // File got shorter while sending
+        if (n == 0)
+            return false;
+        *count -= n;
+    }
+    return true;
+}
+
+bool sendv_fully(int fd, struct iovec* iov, int iovcnt, int flags)
+{
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    for (;;) {
+        // Client is gone or too slow, drop rest of the data
+        if (!sendv_some(fd, &msg, flags))
+            return false;
+        if (msg.msg_iovlen == 0)
+            return true;
+        if (!wait_writable(fd))
+            return false;
+    }
+}
+
+bool send_fully(int fd, const char* buf, size_t len)
+{
+    struct iovec iov;
+    iov.iov_base = (void*)buf;
+    iov.iov_len = len;
+    return sendv_fully(fd, &iov, 1, 0);
+}
+
+bool sendfile_fully(int fd, int file_fd, off_t offset, size_t count)
+{
+    for (;;) {
+        if (!sendfile_some(fd, file_fd, &offset, &count))
+            return false;
+        if (count == 0)
+            return true;
+        if (!wait_writable(fd))
+            return false;
+    }
+}
+
+static void close_pending_file(Connection* conn)
+{
+    if (conn->pending_file == -1)
+        return;
+    close(conn->pending_file);
+    conn->pending_file = -1;
+    conn->pending_count = 0;
+}
+
+/**
+ * @brief send the pending file and the bytes before it, waiting for the
+ * socket. Bytes can't be queued after a file, but requests aren't handled
+ * while output is pending so only the same response can write more.
+ *
+ * @param conn
+ * @return false if the client is gone
+ */
+static bool finish_pending_file(Connection* conn)
+{
+    if (conn->pending_file == -1)
+        return true;
+    bool sent = send_fully(conn->conn_fd, conn->pending.chars, conn->pending.len)
+        && sendfile_fully(conn->conn_fd, conn->pending_file, conn->pending_offset, conn->pending_count);
+    conn->pending.len = 0;
+    close_pending_file(conn);
+    return sent;
+}
+
+bool connection_sendv(Connection* conn, struct iovec* iov, int iovcnt, int flags)
+{
+    if (!conn->defer_writes)
+        return sendv_fully(conn->conn_fd, iov, iovcnt, flags);
+    if (!finish_pending_file(conn))
+        return false;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    // Nothing may overtake the bytes already waiting
+    if (conn->pending.len == 0 && !sendv_some(conn->conn_fd, &msg, flags))
+        return false;
+
+    // Pending output belongs to the connection, not the request arena
+    const Allocator* allocator = memory_use_allocator(NULL);
+    for (size_t i = 0; i < msg.msg_iovlen; i++)
+        string_append_chars(&conn->pending, msg.msg_iov[i].iov_base, (int)msg.msg_iov[i].iov_len);
+    memory_use_allocator(allocator);
+    return true;
+}
+
+bool connection_sendfile(Connection* conn, int file_fd, off_t offset, size_t count)
+{
+    if (!conn->defer_writes)
+        return sendfile_fully(conn->conn_fd, file_fd, offset, count);
+    if (!finish_pending_file(conn))
+        return false;
+
+    if (conn->pending.len == 0) {
+        if (!sendfile_some(conn->conn_fd, file_fd, &offset, &count))
+            return false;
+        if (count == 0)
+            return true;
+    }
+    // File cache may close its descriptor before the rest is sent
+    conn->pending_file = dup(file_fd);
+    if (conn->pending_file == -1)
+        return false;
+    conn->pending_offset = offset;
+    conn->pending_count = count;
+    return true;
+}
+
+bool connection_has_pending(const Connection* conn)
+{
+    return conn->pending.len > 0 || conn->pending_file != -1;
+}
+
+bool connection_send_pending(Connection* conn)
+{
+    if (conn->pending.len > 0) {
+        struct iovec iov;
+        iov.iov_base = conn->pending.chars;
+        iov.iov_len = conn->pending.len;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        // Headers of a pending file go in the same packet as the file
+        if (!sendv_some(conn->conn_fd, &msg, conn->pending_file != -1 ? MSG_MORE : 0))
+            return false;
+
+        int left = msg.msg_iovlen > 0 ? (int)iov.iov_len : 0;
+        memmove(conn->pending.chars, conn->pending.chars + conn->pending.len - left, left);
+        conn->pending.len = left;
+        if (left > 0)
+            return true;
+    }
+
+    if (conn->pending_file != -1) {
+        if (!sendfile_some(conn->conn_fd, conn->pending_file, &conn->pending_offset, &conn->pending_count))
+            return false;
+        if (conn->pending_count == 0)
+            close_pending_file(conn);
+    }
+    return true;
+}
+
+bool connection_flush(Connection* conn)
+{
+    if (conn->out.len == 0)
+        return true;
+    struct iovec iov;
+    iov.iov_base = conn->out.chars;
+    iov.iov_len = conn->out.len;
+    bool sent = connection_sendv(conn, &iov, 1, 0);
+    conn->out.len = 0;
+    return sent;
+}
+
+void close_connection(Connection* conn)
+{
+    connection_flush(conn);
+    close(conn->conn_fd);
+    conn->is_alive = false;
+    STRING_FREE(&conn->buffer);
+    STRING_INIT(&conn->buffer);
+    STRING_FREE(&conn->out);
+    STRING_INIT(&conn->out);
+    // Output the client didn't take before closing is dropped
+    close_pending_file(conn);
+    STRING_FREE(&conn->pending);
+    STRING_INIT(&conn->pending);
+}
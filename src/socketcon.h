@@ -2,14 +2,103 @@
 #define REST_SOCKET_CON_H_
 
 #include <stdbool.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "datatypes.h"
+#include "requests/parser.h"
+
+// Request whose body is passed to its callback while it is received
+struct StreamedRequest;
 
 typedef struct {
     // conn_fd is the socket file descriptor
     int conn_fd;
     // is_alive is updated with ping-pong
     bool is_alive;
+    // Bytes received from the socket. Bytes before consumed are handled
+    String buffer;
+    int consumed;
+    // Progress of the request being received
+    RequestParser parser;
+    struct StreamedRequest* stream;
+    // Responses waiting to be sent with a single write
+    String out;
+    // Writes that would block are left to pending instead of waiting
+    // for the socket. Set by the event loop for its non-blocking sockets
+    bool defer_writes;
+    // Bytes the socket didn't take yet, sent before pending_file
+    String pending;
+    // Duplicate of the file being sent with sendfile or -1
+    int pending_file;
+    off_t pending_offset;
+    size_t pending_count;
+    // Amount of requests read from the connection
+    int requests;
 } Connection;
 
+void init_connection(Connection* conn, int conn_fd);
+/*
+* Receive as much as fits in one read to the connection buffer.
+* Returns the amount of bytes read, 0 when the client has closed the
+* connection and -1 on errors (see errno)
+*/
+int connection_recv(Connection* conn);
+/*
+* Mark len bytes of the unread data as handled
+*/
+void connection_consume(Connection* conn, int len);
+/*
+* Cut the unread data to len bytes
+*/
+void connection_truncate(Connection* conn, int len);
+/*
+* Received bytes that are not consumed yet. The returned String points to
+* the connection buffer and must not be freed
+*/
+String connection_unread(Connection* conn);
+/*
+* Send the whole buffer. Non-blocking sockets are polled until they are
+* writable again. Returns false if the client is gone or too slow and
+* the rest was dropped
+*/
+bool send_fully(int fd, const char* buf, size_t len);
+/*
+* Send all the buffers with as few syscalls as possible.
+* The iov array is modified. flags are passed to sendmsg.
+* Returns false like send_fully
+*/
+bool sendv_fully(int fd, struct iovec* iov, int iovcnt, int flags);
+/*
+* Send count bytes of file_fd from offset without copying them to user space.
+* Returns false if fewer bytes were sent, so the response is cut short
+*/
+bool sendfile_fully(int fd, int file_fd, off_t offset, size_t count);
+/*
+* Send the buffers to the client of the connection like sendv_fully. With
+* defer_writes the part the socket doesn't take right away is copied to
+* pending. Returns false if the client is gone
+*/
+bool connection_sendv(Connection* conn, struct iovec* iov, int iovcnt, int flags);
+/*
+* Send a file to the client of the connection like sendfile_fully. With
+* defer_writes the rest of the file is left pending
+*/
+bool connection_sendfile(Connection* conn, int file_fd, off_t offset, size_t count);
+/*
+* True if some of the output waits for the socket to be writable
+*/
+bool connection_has_pending(const Connection* conn);
+/*
+* Send as much of the pending output as the socket takes without blocking.
+* Returns false if the client is gone
+*/
+bool connection_send_pending(Connection* conn);
+/*
+* Send the responses collected to the out buffer.
+* Returns false if they couldn't be sent
+*/
+bool connection_flush(Connection* conn);
 void handle_connection(Connection* conn);
 void close_connection(Connection* conn);
 
@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t size;
+    size_t used;
+    // Keeps data aligned after the header
+    char data[] __attribute__((aligned(ARENA_ALIGNMENT)));
+};
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static ArenaBlock* new_block(size_t size)
+{
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL)
+        return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void init_arena(Arena* arena, size_t block_size)
+{
+    arena->blocks = NULL;
+    arena->oldest = NULL;
+    arena->free_blocks = NULL;
+    arena->total_size = 0;
+    arena->block_size = ALIGN_UP(block_size);
+    arena->last = NULL;
+}
+
+static void free_blocks(ArenaBlock* block)
+{
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void free_arena(Arena* arena)
+{
+    free_blocks(arena->blocks);
+    free_blocks(arena->free_blocks);
+    arena->blocks = NULL;
+    arena->oldest = NULL;
+    arena->free_blocks = NULL;
+    arena->total_size = 0;
+    arena->last = NULL;
+}
+
+/**
+ * @brief take the smallest free block of at least size bytes so
+ * the blocks of large allocations are left for large allocations.
+ * Of the same size the oldest is taken, so the blocks are used in
+ * the same order after every reset
+ *
+ * @param arena
+ * @param size
+ * @return ArenaBlock* or NULL if no free block is large enough
+ */
+static ArenaBlock* take_free_block(Arena* arena, size_t size)
+{
+    ArenaBlock** best = NULL;
+    for (ArenaBlock** link = &arena->free_blocks; *link != NULL; link = &(*link)->next) {
+        if ((*link)->size >= size && (best == NULL || (*link)->size <= (*best)->size))
+            best = link;
+    }
+    if (best == NULL)
+        return NULL;
+    ArenaBlock* block = *best;
+    *best = block->next;
+    block->used = 0;
+    return block;
+}
+
+void* arena_alloc(Arena* arena, size_t size)
+{
+    size = ALIGN_UP(size);
+    ArenaBlock* block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        // Large allocations get a block of their own
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        block = take_free_block(arena, block_size);
+        if (block == NULL) {
+            block = new_block(block_size);
+            if (block == NULL)
+                return NULL;
+            arena->total_size += block_size;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        if (arena->oldest == NULL)
+            arena->oldest = block;
+    }
+    char* ptr = block->data + block->used;
+    block->used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+void* arena_realloc(Arena* arena, void* previous, size_t old_size, size_t new_size)
+{
+    if (previous == NULL)
+        return arena_alloc(arena, new_size);
+
+    ArenaBlock* block = arena->blocks;
+    if (previous == arena->last) {
+        size_t start = (char*)previous - block->data;
+        if (ALIGN_UP(new_size) <= block->size - start) {
+            block->used = start + ALIGN_UP(new_size);
+            return previous;
+        }
+    }
+    if (new_size <= old_size)
+        return previous;
+
+    void* ptr = arena_alloc(arena, new_size);
+    if (ptr != NULL)
+        memcpy(ptr, previous, old_size);
+    return ptr;
+}
+
+static bool block_owns(const ArenaBlock* block, const void* ptr)
+{
+    return (const char*)ptr >= block->data && (const char*)ptr < block->data + block->size;
+}
+
+bool arena_owns(const Arena* arena, const void* ptr)
+{
+    if (arena->blocks == NULL)
+        return false;
+    // Most allocations are in the newest block
+    if (block_owns(arena->blocks, ptr))
+        return true;
+    for (const ArenaBlock* block = arena->blocks->next; block != NULL; block = block->next) {
+        if (block_owns(block, ptr))
+            return true;
+    }
+    return false;
+}
+
+void arena_reset(Arena* arena)
+{
+    if (arena->blocks == NULL)
+        return;
+    // Blocks in use are moved to the free blocks at once
+    arena->oldest->next = arena->free_blocks;
+    arena->free_blocks = arena->blocks;
+    arena->blocks = NULL;
+    arena->oldest = NULL;
+    arena->last = NULL;
+
+    // Memory of a rare large request is not kept
+    while (arena->total_size > ARENA_KEEP_BLOCKS * arena->block_size) {
+        ArenaBlock* block = arena->free_blocks;
+        arena->free_blocks = block->next;
+        arena->total_size -= block->size;
+        free(block);
+    }
+}
+
+static void* arena_reallocate(void* ctx, void* previous, size_t old_size, size_t new_size)
+{
+    // Single allocations are not freed
+    if (new_size == 0)
+        return NULL;
+    return arena_realloc((Arena*)ctx, previous, old_size, new_size);
+}
+
+static bool arena_allocator_owns(void* ctx, const void* ptr)
+{
+    return arena_owns((Arena*)ctx, ptr);
+}
+
+void init_arena_allocator(Allocator* allocator, Arena* arena)
+{
+    allocator->reallocate = arena_reallocate;
+    allocator->owns = arena_allocator_owns;
+    allocator->ctx = arena;
+}
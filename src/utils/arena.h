@@ -0,0 +1,53 @@
+#ifndef REST_ARENA_H_
+#define REST_ARENA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "memory.h"
+
+// Allocations are aligned for any built-in type
+#define ARENA_ALIGNMENT 16
+// Blocks kept over resets, in multiples of block_size bytes
+#define ARENA_KEEP_BLOCKS 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+/*
+* Bump pointer allocator. Freeing single allocations does nothing,
+* arena_reset releases everything at once.
+*/
+typedef struct {
+    // Blocks in use, newest first. Allocations come from the newest
+    ArenaBlock* blocks;
+    // Oldest block in use, where the free blocks are linked on reset
+    ArenaBlock* oldest;
+    // Blocks released by arena_reset for the next allocations
+    ArenaBlock* free_blocks;
+    // Bytes of the blocks in use and the free blocks
+    size_t total_size;
+    size_t block_size;
+    // Newest allocation, the only one that can grow in place
+    char* last;
+} Arena;
+
+void init_arena(Arena* arena, size_t block_size);
+void free_arena(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+/*
+* Grow or shrink an allocation of the arena. The newest allocation
+* is resized in place, others are copied
+*/
+void* arena_realloc(Arena* arena, void* previous, size_t old_size, size_t new_size);
+bool arena_owns(const Arena* arena, const void* ptr);
+/*
+* Release every allocation. The blocks are kept for the next allocations,
+* only blocks past ARENA_KEEP_BLOCKS * block_size bytes are freed
+*/
+void arena_reset(Arena* arena);
+/*
+* Allocator of the arena for memory_use_allocator
+*/
+void init_arena_allocator(Allocator* allocator, Arena* arena);
+
+#endif
@@ -0,0 +1,89 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "compress.h"
+#include "memory.h"
+
+// 15 window bits and 16 for the gzip header and trailer
+#define GZIP_WINDOW_BITS (15 + 16)
+#define GZIP_MEM_LEVEL 8
+
+typedef struct {
+    z_stream stream;
+    char* out;
+    size_t out_size;
+} GzipContext;
+
+static pthread_key_t context_key;
+static pthread_once_t context_once = PTHREAD_ONCE_INIT;
+
+static void free_context(void* ptr)
+{
+    GzipContext* ctx = ptr;
+    deflateEnd(&ctx->stream);
+    if (ctx->out != NULL)
+        FREE_ARRAY(char, ctx->out, ctx->out_size);
+    FREE(GzipContext, ctx);
+}
+
+static void create_context_key()
+{
+    pthread_key_create(&context_key, free_context);
+}
+
+/**
+ * @brief context of the calling thread, created on the first call
+ *
+ * @return GzipContext* or NULL if zlib couldn't be initialized
+ */
+static GzipContext* thread_context()
+{
+    pthread_once(&context_once, create_context_key);
+    GzipContext* ctx = pthread_getspecific(context_key);
+    if (ctx != NULL)
+        return ctx;
+
+    // Context lives as long as the thread, not the request arena
+    const Allocator* allocator = memory_use_allocator(NULL);
+    ctx = ALLOCATE(GzipContext, 1);
+    memory_use_allocator(allocator);
+    memset(&ctx->stream, 0, sizeof(ctx->stream));
+    if (deflateInit2(&ctx->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+            GZIP_WINDOW_BITS, GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY)
+        != Z_OK) {
+        FREE(GzipContext, ctx);
+        return NULL;
+    }
+    ctx->out = NULL;
+    ctx->out_size = 0;
+    pthread_setspecific(context_key, ctx);
+    return ctx;
+}
+
+const char* gzip_compress(const char* data, int len, int* out_len)
+{
+    GzipContext* ctx = thread_context();
+    if (ctx == NULL || deflateReset(&ctx->stream) != Z_OK)
+        return NULL;
+
+    // The bound is large enough to compress everything in one call
+    size_t bound = deflateBound(&ctx->stream, len);
+    if (bound > ctx->out_size) {
+        const Allocator* allocator = memory_use_allocator(NULL);
+        ctx->out = GROW_ARRAY(ctx->out, char, ctx->out_size, bound);
+        memory_use_allocator(allocator);
+        ctx->out_size = bound;
+    }
+
+    ctx->stream.next_in = (Bytef*)data;
+    ctx->stream.avail_in = len;
+    ctx->stream.next_out = (Bytef*)ctx->out;
+    ctx->stream.avail_out = ctx->out_size;
+    if (deflate(&ctx->stream, Z_FINISH) != Z_STREAM_END)
+        return NULL;
+
+    *out_len = (int)ctx->stream.total_out;
+    return ctx->out;
+}
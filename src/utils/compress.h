@@ -0,0 +1,13 @@
+#ifndef REST_COMPRESS_H_
+#define REST_COMPRESS_H_
+
+/*
+* Compress data to the gzip format. Every thread keeps its own
+* compression context and output buffer so nothing is allocated once
+* they have grown large enough. The result is valid until the next call
+* from the same thread. Returns NULL if the compression fails.
+* deflate is not offered, clients accepting it accept gzip too
+*/
+const char* gzip_compress(const char* data, int len, int* out_len);
+
+#endif
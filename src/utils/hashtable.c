@@ -138,9 +138,9 @@ bool table_delete(Table* table, String* key)
     if (entry->key == NULL)
         return false;
 
-    // Place a tombstone in the entry.
+    // Place a tombstone in the entry, any value but null without a cell
     entry->key = NULL;
-    entry->value = BOOL_VAL(true);
+    entry->value = (DataValue){ TYPE_BOOL, NULL };
 
     return true;
 }
@@ -194,7 +194,7 @@ Table* copy_table(const Table* table)
         }
     }
 
-    Table* new_table = ALLOCATE(Table, 1);
+    Table* new_table = POOL_ALLOCATE(Table);
     new_table->capacity = table->capacity;
     new_table->count = table->count;
     new_table->entries = tmp_entries;
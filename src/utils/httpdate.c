@@ -0,0 +1,110 @@
+#include <string.h>
+
+#include "httpdate.h"
+
+static const char* day_names[] = { "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" };
+static const char* month_names[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+/**
+ * @brief days since 1970-01-01 of the date in proleptic Gregorian calendar.
+ * gmtime and timegm are not thread safe or not standard C so
+ * the conversion is done by hand.
+ */
+static long days_from_civil(long y, int m, int d)
+{
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(long z, long* y, int* m, int* d)
+{
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+static void put_number(char* buf, long value, int digits)
+{
+    for (int i = digits - 1; i >= 0; i--) {
+        buf[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+void format_http_date(time_t t, char* buf)
+{
+    long days = (long)(t / 86400);
+    long secs = (long)(t % 86400);
+    if (secs < 0) {
+        secs += 86400;
+        days--;
+    }
+
+    long year;
+    int month, day;
+    civil_from_days(days, &year, &month, &day);
+
+    // 1970-01-01 was Thursday
+    long weekday = days % 7;
+    if (weekday < 0)
+        weekday += 7;
+
+    memcpy(buf, day_names[weekday], 3);
+    memcpy(buf + 3, ", ", 2);
+    put_number(buf + 5, day, 2);
+    buf[7] = ' ';
+    memcpy(buf + 8, month_names[month - 1], 3);
+    buf[11] = ' ';
+    put_number(buf + 12, year, 4);
+    buf[16] = ' ';
+    put_number(buf + 17, secs / 3600, 2);
+    buf[19] = ':';
+    put_number(buf + 20, secs / 60 % 60, 2);
+    buf[22] = ':';
+    put_number(buf + 23, secs % 60, 2);
+    memcpy(buf + 25, " GMT", 5);
+}
+
+static int parse_number(const char* str, int digits)
+{
+    int value = 0;
+    for (int i = 0; i < digits; i++) {
+        if (str[i] < '0' || str[i] > '9')
+            return -1;
+        value = value * 10 + (str[i] - '0');
+    }
+    return value;
+}
+
+time_t parse_http_date(const char* str, int len)
+{
+    // Only the IMF-fixdate format is accepted, obsolete formats are rare
+    if (len < HTTP_DATE_SIZE - 1 || str[3] != ',' || strncmp(str + 25, " GMT", 4) != 0)
+        return -1;
+
+    int day = parse_number(str + 5, 2);
+    int month = -1;
+    for (int i = 0; i < 12; i++) {
+        if (strncmp(str + 8, month_names[i], 3) == 0)
+            month = i + 1;
+    }
+    int year = parse_number(str + 12, 4);
+    int hour = parse_number(str + 17, 2);
+    int min = parse_number(str + 20, 2);
+    int sec = parse_number(str + 23, 2);
+    if (day < 1 || month < 1 || year < 0 || hour < 0 || min < 0 || sec < 0)
+        return -1;
+
+    return (time_t)days_from_civil(year, month, day) * 86400 + hour * 3600 + min * 60 + sec;
+}
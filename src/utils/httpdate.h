@@ -0,0 +1,18 @@
+#ifndef REST_HTTP_DATE_H_
+#define REST_HTTP_DATE_H_
+
+#include <time.h>
+
+// "Sun, 06 Nov 1994 08:49:37 GMT" and the terminating null
+#define HTTP_DATE_SIZE 30
+
+/*
+* Format t as an IMF-fixdate used by Last-Modified and Date headers
+*/
+void format_http_date(time_t t, char* buf);
+/*
+* Parse an IMF-fixdate. Returns -1 if the date is malformed
+*/
+time_t parse_http_date(const char* str, int len);
+
+#endif
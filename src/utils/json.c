@@ -1,5 +1,6 @@
 
 #include "json.h"
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -54,7 +55,7 @@ JSONValue json_value_number(JSONNumber number)
 {
     JSONValue jval;
     jval.type = TYPE_NUMBER;
-    JSONNumber* tmp = ALLOCATE(JSONNumber, 1);
+    JSONNumber* tmp = POOL_ALLOCATE(JSONNumber);
     *tmp = number;
     jval.data = (void*)tmp;
     return jval;
@@ -94,11 +95,15 @@ void free_json(JSONObject* obj)
                 STRINGP_FREE((String*)obj->entries[i].value.data);
             } else if (obj->entries[i].value.type == TYPE_ARRAY) {
                 free_json_array((Array*)obj->entries[i].value.data);
+            } else if (obj->entries[i].value.type == TYPE_NUMBER) {
+                POOL_FREE(JSONNumber, obj->entries[i].value.data);
+            } else if (obj->entries[i].value.type == TYPE_BOOL) {
+                POOL_FREE(JSONBool, obj->entries[i].value.data);
             }
         }
     }
     free_table(obj);
-    FREE(JSONObject, obj);
+    POOL_FREE(JSONObject, obj);
 }
 
 void free_json_array(JSONArray* arr)
@@ -114,11 +119,19 @@ void free_json_array(JSONArray* arr)
             break;
         case TYPE_STRING:
             STRINGP_FREE((String*)arr->values[i].data);
+            break;
+        case TYPE_NUMBER:
+            POOL_FREE(JSONNumber, arr->values[i].data);
+            break;
+        case TYPE_BOOL:
+            POOL_FREE(JSONBool, arr->values[i].data);
+            break;
         default:
             break;
         }
     }
-    free(arr);
+    FREE_ARRAY(DataValue, arr->values, arr->capacity);
+    POOL_FREE(JSONArray, arr);
 }
 
 String* json_get_string(JSONObject* obj, String* kw)
@@ -243,7 +256,7 @@ JSONNumber* json_get_number_c(JSONObject* obj, const char* kw)
 bool json_add_number(JSONObject* obj, String* kw, JSONNumber number)
 {
     JSONValue jval;
-    JSONNumber* tmp = ALLOCATE(JSONNumber, 1);
+    JSONNumber* tmp = POOL_ALLOCATE(JSONNumber);
     *tmp = number;
     jval.type = TYPE_NUMBER;
     jval.data = (void*)tmp;
@@ -348,7 +361,7 @@ static JSONValue json_object_value(JSONObject* obj)
 static JSONValue json_boolean_value(bool b)
 {
     JSONValue val;
-    bool* tmp = ALLOCATE(bool, 1);
+    bool* tmp = POOL_ALLOCATE(bool);
     *tmp = b;
     val.type = TYPE_BOOL;
     val.data = (void*)tmp;
@@ -366,7 +379,7 @@ static JSONValue json_null_value()
 static JSONValue json_number_value(JSONToken token)
 {
     JSONValue val;
-    float* d = ALLOCATE(float, 1);
+    float* d = POOL_ALLOCATE(float);
     *d = strtof(token.chars->chars, NULL);
     val.type = TYPE_NUMBER;
     val.data = (void*)d;
@@ -405,7 +418,7 @@ static bool parse_keyword(JSONTokenArray* t_array, JSONObject* to)
         return table_set(to, copy_string(keyword.chars), val);
     } break;
     case T_BRACE_OPEN: {
-        JSONObject* obj = ALLOCATE(JSONObject, 1);
+        JSONObject* obj = POOL_ALLOCATE(JSONObject);
         init_table(obj);
         if (parse_object(t_array, obj)) {
             JSONValue val = json_object_value(obj);
@@ -414,7 +427,7 @@ static bool parse_keyword(JSONTokenArray* t_array, JSONObject* to)
         }
     } break;
     case T_SQUARE_OPEN: {
-        JSONArray* arr = ALLOCATE(JSONArray, 1);
+        JSONArray* arr = POOL_ALLOCATE(JSONArray);
         init_array(arr);
         if (parse_array(t_array, arr)) {
             JSONValue val = json_array_value(arr);
@@ -476,7 +489,7 @@ static bool parse_array(JSONTokenArray* t_array, JSONArray* to)
             val = json_string_value(current);
             break;
         case T_BRACE_OPEN: {
-            JSONObject* obj = ALLOCATE(JSONObject, 1);
+            JSONObject* obj = POOL_ALLOCATE(JSONObject);
             init_table(obj);
             if (parse_object(t_array, obj))
                 val = json_object_value(obj);
@@ -499,9 +512,7 @@ static bool parse_array(JSONTokenArray* t_array, JSONArray* to)
             return false;
         }
 
-        to->values = GROW_ARRAY(to->values, JSONValue, 0, to->length + 1);
-        to->values[to->length] = val;
-        to->length++;
+        json_array_append_value(to, val);
     } while (advance_token(t_array).type == T_COMMA);
 
     if (current_token(t_array).type != T_SQUARE_CLOSE)
@@ -739,7 +750,7 @@ static void json_value_to_string(JSONValue* val, JSONString* to)
 
 JSONString* json_to_string(JSONObject* obj)
 {
-    JSONString* str = ALLOCATE(String, 1);
+    JSONString* str = POOL_ALLOCATE(String);
     STRING_INIT(str);
     json_obj_to_string(obj, str);
     // Json string gets malformed if we append null to it
@@ -750,7 +761,7 @@ JSONString* json_to_string(JSONObject* obj)
 JSONObject* parse_json(String* data, bool* result_value)
 {
 
-    JSONObject* json = ALLOCATE(JSONObject, 1);
+    JSONObject* json = POOL_ALLOCATE(JSONObject);
     init_table(json);
     JSONTokenArray t_array;
     create_tokens(data, &t_array);
@@ -764,3 +775,178 @@ JSONObject* parse_json(String* data, bool* result_value)
 
     return json;
 }
+
+void json_writer_init(JSONWriter* w, JSONWriteCallback write, void* ctx)
+{
+    w->write = write;
+    w->ctx = ctx;
+    w->depth = 0;
+    w->has_value[0] = false;
+    w->after_key = false;
+    w->failed = false;
+    w->fail = NULL;
+}
+
+/**
+ * @brief write the comma between the values of a container
+ *
+ * @param w
+ */
+static void json_writer_separate(JSONWriter* w)
+{
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->has_value[w->depth])
+        w->write(w->ctx, ",", 1);
+    w->has_value[w->depth] = true;
+}
+
+static void json_writer_fail(JSONWriter* w)
+{
+    w->failed = true;
+    if (w->fail != NULL)
+        w->fail(w->ctx);
+}
+
+static void json_writer_open(JSONWriter* w, char bracket)
+{
+    // Commas of deeper containers couldn't be tracked
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        json_writer_fail(w);
+        return;
+    }
+    json_writer_separate(w);
+    w->write(w->ctx, &bracket, 1);
+    w->depth++;
+    w->has_value[w->depth] = false;
+}
+
+static void json_writer_close(JSONWriter* w, char bracket)
+{
+    if (w->depth > 0)
+        w->depth--;
+    w->write(w->ctx, &bracket, 1);
+}
+
+void json_writer_begin_object(JSONWriter* w)
+{
+    if (!w->failed)
+        json_writer_open(w, '{');
+}
+
+void json_writer_end_object(JSONWriter* w)
+{
+    if (!w->failed)
+        json_writer_close(w, '}');
+}
+
+void json_writer_begin_array(JSONWriter* w)
+{
+    if (!w->failed)
+        json_writer_open(w, '[');
+}
+
+void json_writer_end_array(JSONWriter* w)
+{
+    if (!w->failed)
+        json_writer_close(w, ']');
+}
+
+/**
+ * @brief write a quoted string. Quotes, backslashes and control
+ * characters are escaped, runs of plain characters are written at once.
+ *
+ * @param w
+ * @param str
+ * @param len
+ */
+static void json_writer_quote(JSONWriter* w, const char* str, int len)
+{
+    w->write(w->ctx, "\"", 1);
+    int start = 0;
+    for (int i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if (c != '"' && c != '\\' && c >= 0x20)
+            continue;
+        if (i > start)
+            w->write(w->ctx, str + start, i - start);
+        char escape[8];
+        int escape_len;
+        if (c == '"' || c == '\\')
+            escape_len = snprintf(escape, sizeof(escape), "\\%c", c);
+        else if (c == '\n')
+            escape_len = snprintf(escape, sizeof(escape), "\\n");
+        else
+            escape_len = snprintf(escape, sizeof(escape), "\\u%04x", c);
+        w->write(w->ctx, escape, escape_len);
+        start = i + 1;
+    }
+    if (len > start)
+        w->write(w->ctx, str + start, len - start);
+    w->write(w->ctx, "\"", 1);
+}
+
+void json_writer_key(JSONWriter* w, const char* key)
+{
+    if (w->failed)
+        return;
+    json_writer_separate(w);
+    json_writer_quote(w, key, (int)strlen(key));
+    w->write(w->ctx, ":", 1);
+    w->after_key = true;
+}
+
+void json_writer_string(JSONWriter* w, const char* str, int len)
+{
+    if (w->failed)
+        return;
+    json_writer_separate(w);
+    json_writer_quote(w, str, len);
+}
+
+void json_writer_number(JSONWriter* w, JSONNumber number)
+{
+    if (w->failed)
+        return;
+    // JSON has no NaN or infinity
+    if (!isfinite(number)) {
+        json_writer_fail(w);
+        return;
+    }
+    json_writer_separate(w);
+    char numstr[50];
+    // Enough digits to read back the same number
+    int numlen = snprintf(numstr, 50, "%.17g", number);
+    w->write(w->ctx, numstr, numlen);
+}
+
+void json_writer_bool(JSONWriter* w, JSONBool boolean)
+{
+    if (w->failed)
+        return;
+    json_writer_separate(w);
+    if (boolean)
+        w->write(w->ctx, "true", 4);
+    else
+        w->write(w->ctx, "false", 5);
+}
+
+void json_writer_null(JSONWriter* w)
+{
+    if (w->failed)
+        return;
+    json_writer_separate(w);
+    w->write(w->ctx, "null", 4);
+}
+
+void json_writer_object(JSONWriter* w, JSONObject* obj)
+{
+    if (w->failed)
+        return;
+    json_writer_separate(w);
+    JSONString* str = json_to_string(obj);
+    w->write(w->ctx, str->chars, str->len);
+    STRINGP_FREE(str);
+}
@@ -59,4 +59,42 @@ bool json_add_array_c(JSONObject* obj, const char* kw, JSONArray* arr);
 JSONObject* parse_json(String* data, bool* result_value);
 JSONString* json_to_string(JSONObject* obj);
 
+// Containers nested deeper than this fail the writer
+#define JSON_WRITER_MAX_DEPTH 32
+
+typedef void (*JSONWriteCallback)(void* ctx, const char* chars, int len);
+typedef void (*JSONFailCallback)(void* ctx);
+
+/*
+* Writes JSON piece by piece without building the document in memory.
+* Every value is passed to the callback as soon as it's written
+*/
+typedef struct {
+    JSONWriteCallback write;
+    void* ctx;
+    int depth;
+    // Container at the depth has a value and the next one needs a comma
+    bool has_value[JSON_WRITER_MAX_DEPTH + 1];
+    // Key was written and its value comes next
+    bool after_key;
+    // Document can't be written anymore, nothing more is written
+    bool failed;
+    // Called once when the writer fails, can be NULL
+    JSONFailCallback fail;
+} JSONWriter;
+
+void json_writer_init(JSONWriter* w, JSONWriteCallback write, void* ctx);
+void json_writer_begin_object(JSONWriter* w);
+void json_writer_end_object(JSONWriter* w);
+void json_writer_begin_array(JSONWriter* w);
+void json_writer_end_array(JSONWriter* w);
+void json_writer_key(JSONWriter* w, const char* key);
+void json_writer_string(JSONWriter* w, const char* str, int len);
+// NaN and infinity can't be written and fail the writer
+void json_writer_number(JSONWriter* w, JSONNumber number);
+void json_writer_bool(JSONWriter* w, JSONBool boolean);
+void json_writer_null(JSONWriter* w);
+// Write a whole object, e.g. one element of a long array
+void json_writer_object(JSONWriter* w, JSONObject* obj);
+
 #endif
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 
-void* __reallocate(void* previous, size_t oldSize, size_t newSize)
+#include "memory.h"
+
+static void* heap_reallocate(void* ctx, void* previous, size_t oldSize, size_t newSize)
 {
     if (newSize == 0) {
         free(previous);
@@ -9,3 +11,60 @@ void* __reallocate(void* previous, size_t oldSize, size_t newSize)
 
     return realloc(previous, newSize);
 }
+
+const Allocator heap_allocator = { heap_reallocate, NULL, NULL };
+
+static const Allocator* default_allocator = &heap_allocator;
+// Allocators of the server thread and of the request it is handling
+static __thread const Allocator* thread_allocator = NULL;
+static __thread const Allocator* request_allocator = NULL;
+
+void memory_set_default_allocator(const Allocator* allocator)
+{
+    default_allocator = allocator != NULL ? allocator : &heap_allocator;
+}
+
+const Allocator* memory_use_thread_allocator(const Allocator* allocator)
+{
+    const Allocator* previous = thread_allocator;
+    // Without owns it would take the memory of the other allocators
+    if (allocator == NULL || allocator->owns != NULL)
+        thread_allocator = allocator;
+    return previous;
+}
+
+const Allocator* memory_use_allocator(const Allocator* allocator)
+{
+    const Allocator* previous = request_allocator;
+    if (allocator == NULL || allocator->owns != NULL)
+        request_allocator = allocator;
+    return previous;
+}
+
+static bool owns(const Allocator* allocator, const void* ptr)
+{
+    return allocator->owns(allocator->ctx, ptr);
+}
+
+bool memory_in_request(void)
+{
+    return request_allocator != NULL;
+}
+
+bool memory_request_owns(const void* ptr)
+{
+    return request_allocator != NULL && owns(request_allocator, ptr);
+}
+
+void* __reallocate(void* previous, size_t oldSize, size_t newSize)
+{
+    const Allocator* allocator = default_allocator;
+    // Memory allocated before an allocator was taken into use
+    // is left to the one it came from
+    if (request_allocator != NULL && (previous == NULL || owns(request_allocator, previous)))
+        allocator = request_allocator;
+    else if (thread_allocator != NULL && (previous == NULL || owns(thread_allocator, previous)))
+        allocator = thread_allocator;
+
+    return allocator->reallocate(allocator->ctx, previous, oldSize, newSize);
+}
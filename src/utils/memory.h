@@ -1,6 +1,7 @@
 #ifndef REST_MEMORY_H_
 #define REST_MEMORY_H_
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 #define ALLOCATE(type, count) \
@@ -19,6 +20,48 @@
 #define FREE_ARRAY(type, pointer, oldCount) \
     __reallocate(pointer, sizeof(type) * (oldCount), 0)
 
+/*
+* Memory behind ALLOCATE, GROW_ARRAY and FREE.
+* New memory comes from the request allocator of the calling thread,
+* or its thread allocator, or the default allocator. Memory is grown
+* and freed by the first of them that owns it.
+*/
+typedef struct {
+    // Like realloc: NULL previous allocates and 0 new_size frees
+    void* (*reallocate)(void* ctx, void* previous, size_t old_size, size_t new_size);
+    // True if ptr was allocated by this allocator. Only the default
+    // allocator may leave it NULL and take any pointer, like the heap
+    bool (*owns)(void* ctx, const void* ptr);
+    void* ctx;
+} Allocator;
+
+// realloc and free
+extern const Allocator heap_allocator;
+
 void* __reallocate(void* previous, size_t oldSize, size_t newSize);
+/*
+* Replace the heap for the whole program. Call before anything is
+* allocated with the library
+*/
+void memory_set_default_allocator(const Allocator* allocator);
+/*
+* Allocator of everything the calling thread allocates, NULL uses the
+* default allocator. Allocators without owns are ignored.
+* Returns the previous one
+*/
+const Allocator* memory_use_thread_allocator(const Allocator* allocator);
+/*
+* Allocator of the request the calling thread is handling, NULL goes
+* back to the thread allocator. Allocators without owns are ignored.
+* Returns the previous one.
+* Memory of an allocator must not be freed or grown after it's not in
+* use anymore, so objects outliving the request are allocated with it
+* set NULL
+*/
+const Allocator* memory_use_allocator(const Allocator* allocator);
+// True while the calling thread has a request allocator in use
+bool memory_in_request(void);
+// True if ptr belongs to the request allocator of the calling thread
+bool memory_request_owns(const void* ptr);
 
 #endif
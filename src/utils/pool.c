@@ -0,0 +1,94 @@
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "pool.h"
+
+#define CLASS_COUNT (POOL_MAX_SIZE / POOL_ALIGNMENT)
+#define CLASS_OF(size) (((size) + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT - 1)
+#define CLASS_SIZE(class) (((class) + 1) * POOL_ALIGNMENT)
+
+typedef struct PoolNode {
+    struct PoolNode* next;
+} PoolNode;
+
+typedef struct {
+    PoolNode* free;
+    int count;
+} SizeClass;
+
+static __thread SizeClass classes[CLASS_COUNT];
+// Objects of the thread are given back when it exits
+static __thread bool registered = false;
+static pthread_key_t trim_key;
+static pthread_once_t trim_once = PTHREAD_ONCE_INIT;
+
+static void trim_thread(void* ptr)
+{
+    pool_trim();
+}
+
+static void create_trim_key()
+{
+    pthread_key_create(&trim_key, trim_thread);
+}
+
+/**
+ * @brief make pool_trim run when the calling thread exits. The
+ * destructor of the key only runs for threads with a value set
+ */
+static void register_thread()
+{
+    pthread_once(&trim_once, create_trim_key);
+    pthread_setspecific(trim_key, classes);
+    registered = true;
+}
+
+void* pool_alloc(size_t size)
+{
+    if (size == 0 || size > POOL_MAX_SIZE || memory_in_request())
+        return __reallocate(NULL, 0, size);
+
+    SizeClass* sc = &classes[CLASS_OF(size)];
+    if (sc->free == NULL)
+        return __reallocate(NULL, 0, CLASS_SIZE(CLASS_OF(size)));
+    PoolNode* node = sc->free;
+    sc->free = node->next;
+    sc->count--;
+    return node;
+}
+
+void pool_free(void* pointer, size_t size)
+{
+    if (pointer == NULL)
+        return;
+    if (size == 0 || size > POOL_MAX_SIZE || memory_request_owns(pointer)) {
+        __reallocate(pointer, size, 0);
+        return;
+    }
+
+    size_t class = CLASS_OF(size);
+    SizeClass* sc = &classes[class];
+    if (sc->count >= POOL_MAX_FREE) {
+        __reallocate(pointer, CLASS_SIZE(class), 0);
+        return;
+    }
+    if (!registered)
+        register_thread();
+    PoolNode* node = pointer;
+    node->next = sc->free;
+    sc->free = node;
+    sc->count++;
+}
+
+void pool_trim(void)
+{
+    for (size_t class = 0; class < CLASS_COUNT; class++) {
+        SizeClass* sc = &classes[class];
+        while (sc->free != NULL) {
+            PoolNode* next = sc->free->next;
+            __reallocate(sc->free, CLASS_SIZE(class), 0);
+            sc->free = next;
+        }
+        sc->count = 0;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef REST_POOL_H_
+#define REST_POOL_H_
+
+#include <stddef.h>
+
+#include "memory.h"
+
+// Size classes are multiples of this up to POOL_MAX_SIZE bytes
+#define POOL_ALIGNMENT 8
+#define POOL_MAX_SIZE 64
+// Freed objects kept per size class and thread
+#define POOL_MAX_FREE 1024
+
+#define POOL_ALLOCATE(type) \
+    (type*)pool_alloc(sizeof(type))
+
+#define POOL_FREE(type, pointer) \
+    pool_free(pointer, sizeof(type))
+
+/*
+* Free lists of the small objects allocated and freed for every JSON
+* value and string: String headers, Tables and number and bool cells.
+* Freed objects are kept for the next allocation of the same size class
+* of the calling thread. While a request allocator is in use the objects
+* come from it and are never kept, the allocator releases them.
+* Objects allocated with pool_alloc must be freed with pool_free.
+* pool_free rounds size up to its class and hands the object out again
+* at that size. So the only other objects it takes are ones from
+* ALLOCATE with a size that is a multiple of POOL_ALIGNMENT, like the
+* Tables of JSON objects. Smaller ones, e.g. ALLOCATE(bool, 1), would
+* be overrun
+*/
+void* pool_alloc(size_t size);
+void pool_free(void* pointer, size_t size);
+/*
+* Give the objects kept by the calling thread back to the allocator.
+* Called when a thread that kept objects exits
+*/
+void pool_trim(void);
+
+#endif
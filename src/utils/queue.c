@@ -0,0 +1,107 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memory.h"
+#include "queue.h"
+
+void init_work_queue(WorkQueue* q, int capacity)
+{
+    size_t size = 2;
+    while (size < (size_t)capacity)
+        size *= 2;
+
+    q->cells = ALLOCATE(QueueCell, size);
+    for (size_t i = 0; i < size; i++) {
+        q->cells[i].sequence = i;
+        q->cells[i].value = -1;
+    }
+    q->mask = size - 1;
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    sem_init(&q->items, 0, 0);
+    sem_init(&q->slots, 0, (unsigned int)size);
+}
+
+void free_work_queue(WorkQueue* q)
+{
+    sem_destroy(&q->items);
+    sem_destroy(&q->slots);
+    FREE_ARRAY(QueueCell, q->cells, q->mask + 1);
+    q->cells = NULL;
+}
+
+static void sem_wait_nointr(sem_t* sem)
+{
+    while (sem_wait(sem) == -1 && errno == EINTR)
+        ;
+}
+
+/**
+ * @brief Claim the cell at enqueue_pos and publish the value to it.
+ * The slots semaphore guarantees that there is a free cell so this never fails.
+ */
+static void enqueue(WorkQueue* q, int value)
+{
+    QueueCell* cell;
+    size_t pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else {
+            // Popper hasn't released the cell yet or another pusher took it
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    cell->value = value;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+static int dequeue(WorkQueue* q)
+{
+    QueueCell* cell;
+    size_t pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else {
+            // Pusher hasn't published the cell yet or another popper took it
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+    int value = cell->value;
+    __atomic_store_n(&cell->sequence, pos + q->mask + 1, __ATOMIC_RELEASE);
+    return value;
+}
+
+void work_queue_push(WorkQueue* q, int value)
+{
+    sem_wait_nointr(&q->slots);
+    enqueue(q, value);
+    sem_post(&q->items);
+}
+
+int work_queue_pop(WorkQueue* q)
+{
+    sem_wait_nointr(&q->items);
+    int value = dequeue(q);
+    sem_post(&q->slots);
+    return value;
+}
+
+int work_queue_waiting(WorkQueue* q)
+{
+    int value = 0;
+    sem_getvalue(&q->items, &value);
+    return value;
+}
@@ -0,0 +1,44 @@
+#ifndef REST_QUEUE_H_
+#define REST_QUEUE_H_
+
+#include <semaphore.h>
+#include <stddef.h>
+
+typedef struct {
+    size_t sequence;
+    int value;
+} QueueCell;
+
+// Keep the producer and consumer positions on their own cache lines
+#define QUEUE_CACHE_LINE 64
+
+/*
+* Bounded lock-free multi-producer multi-consumer queue of ints.
+* Pushing blocks while the queue is full and popping blocks while it's empty.
+*/
+typedef struct {
+    QueueCell* cells;
+    size_t mask;
+    char _pad0[QUEUE_CACHE_LINE];
+    size_t enqueue_pos;
+    char _pad1[QUEUE_CACHE_LINE];
+    size_t dequeue_pos;
+    char _pad2[QUEUE_CACHE_LINE];
+    sem_t items; // amount of values ready to be popped
+    sem_t slots; // amount of free cells
+} WorkQueue;
+
+/*
+* Capacity is rounded up to the next power of two
+*/
+void init_work_queue(WorkQueue* q, int capacity);
+void free_work_queue(WorkQueue* q);
+void work_queue_push(WorkQueue* q, int value);
+int work_queue_pop(WorkQueue* q);
+/*
+* Amount of values waiting to be popped. Only a hint while other
+* threads push and pop
+*/
+int work_queue_waiting(WorkQueue* q);
+
+#endif
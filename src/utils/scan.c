@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+typedef int (*FindAnyFn)(const char* s, int len, const char* set, int set_len);
+
+static int find_any_tail(const char* s, int start, int len, const char* set, int set_len)
+{
+    for (int i = start; i < len; i++) {
+        for (int j = 0; j < set_len; j++) {
+            if (s[i] == set[j])
+                return i;
+        }
+    }
+    return len;
+}
+
+static int find_any_scalar(const char* s, int len, const char* set, int set_len)
+{
+    return find_any_tail(s, 0, len, set, set_len);
+}
+
+#ifdef SCAN_X86
+/**
+ * @brief compare 16 bytes at a time to the whole set with PCMPESTRI
+ */
+__attribute__((target("sse4.2"))) static int find_any_sse42(const char* s, int len,
+    const char* set, int set_len)
+{
+    char set_buf[SCAN_SET_SIZE] = { 0 };
+    memcpy(set_buf, set, set_len);
+    __m128i needles = _mm_loadu_si128((const __m128i*)set_buf);
+
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(s + i));
+        int index = _mm_cmpestri(needles, set_len, block, 16,
+            _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (index != 16)
+            return i + index;
+    }
+    return find_any_tail(s, i, len, set, set_len);
+}
+
+/**
+ * @brief compare 32 bytes at a time to every character of the set
+ */
+__attribute__((target("avx2"))) static int find_any_avx2(const char* s, int len,
+    const char* set, int set_len)
+{
+    __m256i needles[SCAN_SET_SIZE];
+    for (int j = 0; j < set_len; j++)
+        needles[j] = _mm256_set1_epi8(set[j]);
+
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i found = _mm256_cmpeq_epi8(block, needles[0]);
+        for (int j = 1; j < set_len; j++)
+            found = _mm256_or_si256(found, _mm256_cmpeq_epi8(block, needles[j]));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(found);
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return find_any_tail(s, i, len, set, set_len);
+}
+#endif
+
+static int find_any_dispatch(const char* s, int len, const char* set, int set_len);
+
+static FindAnyFn find_any = find_any_dispatch;
+
+/**
+ * @brief pick the implementation on the first call. Every thread
+ * picks the same one so the race on find_any is harmless.
+ */
+static int find_any_dispatch(const char* s, int len, const char* set, int set_len)
+{
+    FindAnyFn fn = find_any_scalar;
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        fn = find_any_avx2;
+    else if (__builtin_cpu_supports("sse4.2"))
+        fn = find_any_sse42;
+#endif
+    __atomic_store_n(&find_any, fn, __ATOMIC_RELAXED);
+    return fn(s, len, set, set_len);
+}
+
+bool scan_use(ScanImpl impl)
+{
+    FindAnyFn fn = find_any_dispatch;
+    switch (impl) {
+    case SCAN_AUTO:
+        break;
+    case SCAN_SCALAR:
+        fn = find_any_scalar;
+        break;
+#ifdef SCAN_X86
+    case SCAN_SSE42:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("sse4.2"))
+            return false;
+        fn = find_any_sse42;
+        break;
+    case SCAN_AVX2:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("avx2"))
+            return false;
+        fn = find_any_avx2;
+        break;
+#endif
+    default:
+        return false;
+    }
+    __atomic_store_n(&find_any, fn, __ATOMIC_RELAXED);
+    return true;
+}
+
+int scan_find_any(const char* s, int len, const char* set, int set_len)
+{
+    if (set_len <= 0)
+        return len;
+    if (set_len > SCAN_SET_SIZE)
+        set_len = SCAN_SET_SIZE;
+    FindAnyFn fn = __atomic_load_n(&find_any, __ATOMIC_RELAXED);
+    return fn(s, len, set, set_len);
+}
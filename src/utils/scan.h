@@ -0,0 +1,29 @@
+#ifndef REST_SCAN_H_
+#define REST_SCAN_H_
+
+#include <stdbool.h>
+
+// Most characters scan_find_any can search at once
+#define SCAN_SET_SIZE 16
+
+/*
+* Offset of the first character of s that is one of the set_len characters
+* in set. Returns len if there is none. The fastest implementation the CPU
+* supports (AVX2, SSE4.2 or plain C) is chosen on the first call.
+*/
+int scan_find_any(const char* s, int len, const char* set, int set_len);
+
+typedef enum {
+    SCAN_AUTO,
+    SCAN_SCALAR,
+    SCAN_SSE42,
+    SCAN_AVX2
+} ScanImpl;
+
+/*
+* Make scan_find_any use impl, for tests and benchmarks. SCAN_AUTO picks
+* the fastest one again. Returns false if the CPU doesn't support impl
+*/
+bool scan_use(ScanImpl impl);
+
+#endif
@@ -0,0 +1,211 @@
+/*
+* Route matching benchmark. Registers thousands of synthetic urls and
+* measures the time and the allocations of a lookup.
+*
+* cmake --build build --target route_bench && ./build/route_bench [routes]
+*/
+#include "../../src/server.h"
+#include "../../src/utils/arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Count the allocations of the whole program. glibc exports the real
+// functions under these names
+extern void* __libc_malloc(size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+
+static long allocations = 0;
+
+void* malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    allocations++;
+    return __libc_calloc(n, size);
+}
+
+#define URL_SIZE 128
+#define ROUNDS 2000000
+
+static void route_callback(Response* r, Request* req)
+{
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief endpoint number i and a url it matches.
+ * Every fourth url is static, then a parameter at the end, deep nesting
+ * with parameters between static segments and long shared prefixes
+ *
+ * @param i
+ * @param endpoint
+ * @param url
+ */
+static void synthetic_route(int i, char* endpoint, char* url)
+{
+    switch (i % 4) {
+    case 0:
+        snprintf(endpoint, URL_SIZE, "/api/v1/resource%d/items", i);
+        snprintf(url, URL_SIZE, "/api/v1/resource%d/items", i);
+        break;
+    case 1:
+        snprintf(endpoint, URL_SIZE, "/api/v1/resource%d/:id", i);
+        snprintf(url, URL_SIZE, "/api/v1/resource%d/%d", i, i * 7);
+        break;
+    case 2:
+        snprintf(endpoint, URL_SIZE, "/org/:org/team%d/:team/member/:member/role", i);
+        snprintf(url, URL_SIZE, "/org/acme/team%d/core/member/%d/role", i, i);
+        break;
+    default:
+        snprintf(endpoint, URL_SIZE, "/static/assets/images/thumbnails/size%d/x", i);
+        snprintf(url, URL_SIZE, "/static/assets/images/thumbnails/size%d/x", i);
+        break;
+    }
+}
+
+typedef struct {
+    const char* name;
+    String* urls;
+    int count;
+} UrlSet;
+
+static void report(const char* name, double ns, long allocs, long ops)
+{
+    printf("%-32s %10.1f ns/op %8.2f allocs/op\n", name, ns / ops, (double)allocs / ops);
+}
+
+static void bench_lookup(RestServer* rs, UrlSet* set)
+{
+    long found = 0;
+    long allocs = allocations;
+    double start = now_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        if (get_call_back(rs, &set->urls[i % set->count]) != NULL)
+            found++;
+    }
+    double ns = now_ns() - start;
+    allocs = allocations - allocs;
+    char name[64];
+    snprintf(name, sizeof(name), "get_call_back %s", set->name);
+    report(name, ns, allocs, ROUNDS);
+    if (found != 0 && found != ROUNDS)
+        printf("  only %ld of %d lookups matched\n", found, ROUNDS);
+}
+
+static void bench_params(RestServer* rs, UrlSet* set)
+{
+    Request r;
+    init_request(&r);
+    unsigned allowed;
+    long allocs = allocations;
+    double start = now_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        r.uri = set->urls[i % set->count];
+        get_request_call_back(rs, &r, &allowed);
+    }
+    double ns = now_ns() - start;
+    allocs = allocations - allocs;
+    report("get_request_call_back", ns, allocs, ROUNDS);
+    STRING_INIT(&r.uri);
+    free_request(&r);
+}
+
+/**
+ * @brief build the JSON view of the parameters like a callback using
+ * request_params would, with the heap or with an arena emptied after
+ * every request
+ *
+ * @param rs
+ * @param set
+ * @param arena NULL for the default allocator
+ */
+static void bench_params_json(RestServer* rs, UrlSet* set, Arena* arena)
+{
+    Allocator allocator;
+    if (arena != NULL)
+        init_arena_allocator(&allocator, arena);
+    Request r;
+    init_request(&r);
+    unsigned allowed;
+    long allocs = allocations;
+    double start = now_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        if (arena != NULL)
+            memory_use_allocator(&allocator);
+        r.uri = set->urls[i % set->count];
+        if (get_request_call_back(rs, &r, &allowed) != NULL)
+            request_params(&r);
+        request_reserve_params(&r, 0);
+        if (arena != NULL) {
+            memory_use_allocator(NULL);
+            arena_reset(arena);
+        }
+    }
+    double ns = now_ns() - start;
+    allocs = allocations - allocs;
+    report(arena != NULL ? "request_params arena" : "request_params heap", ns, allocs, ROUNDS);
+    STRING_INIT(&r.uri);
+    free_request(&r);
+}
+
+int main(int argc, char const* argv[])
+{
+    int routes = argc > 1 ? atoi(argv[1]) : 4096;
+    if (routes < 4)
+        routes = 4;
+
+    RestServer rs;
+    init_server(&rs);
+    char endpoint[URL_SIZE];
+    char url[URL_SIZE];
+    UrlSet hits = { "hit", ALLOCATE(String, routes), routes };
+    UrlSet misses = { "miss", ALLOCATE(String, routes), routes };
+    long allocs = allocations;
+    double start = now_ns();
+    for (int i = 0; i < routes; i++) {
+        synthetic_route(i, endpoint, url);
+        add_url(&rs, endpoint, route_callback);
+    }
+    double ns = now_ns() - start;
+    report("add_url", ns, allocations - allocs, routes);
+
+    for (int i = 0; i < routes; i++) {
+        synthetic_route(i, endpoint, url);
+        STRING_INIT(&hits.urls[i]);
+        string_append_chars(&hits.urls[i], url, (int)strlen(url));
+        // Walks the whole url before failing
+        strcat(url, "/#");
+        STRING_INIT(&misses.urls[i]);
+        string_append_chars(&misses.urls[i], url, (int)strlen(url));
+    }
+
+    printf("%d routes, %d lookups\n", routes, ROUNDS);
+    bench_lookup(&rs, &hits);
+    bench_lookup(&rs, &misses);
+    bench_params(&rs, &hits);
+    bench_params_json(&rs, &hits, NULL);
+    Arena arena;
+    init_arena(&arena, 4096);
+    bench_params_json(&rs, &hits, &arena);
+    free_arena(&arena);
+    return EXIT_SUCCESS;
+}
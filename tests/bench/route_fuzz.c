@@ -0,0 +1,198 @@
+/*
+* Differential fuzzer of the router. Random patterns and urls from a
+* small alphabet share long prefixes, and every match is compared with a
+* reference matcher that checks the patterns one segment at a time.
+*
+* cmake --build build --target route_fuzz && ./build/route_fuzz [iterations] [seed]
+*/
+#include "../../src/router.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERNS 48
+#define URLS 256
+#define MAX_LEN 64
+#define MAX_SEGMENTS 8
+
+static const char* pieces[] = { "a", "b", "ab", "ba", "aa", "abc", "" };
+#define PIECE_COUNT (int)(sizeof(pieces) / sizeof(pieces[0]))
+
+typedef struct {
+    char text[MAX_LEN];
+    // Pattern with the parameter names removed, the same route for the router
+    char shape[MAX_LEN];
+    int params;
+} Pattern;
+
+static void random_pattern(Pattern* p)
+{
+    int segments = 1 + rand() % 4;
+    int len = 0;
+    int shape_len = 0;
+    p->params = 0;
+    for (int i = 0; i < segments; i++) {
+        if (rand() % 3 == 0) {
+            len += snprintf(p->text + len, MAX_LEN - len, "/:p%d", rand() % 3);
+            shape_len += snprintf(p->shape + shape_len, MAX_LEN - shape_len, "/:");
+            p->params++;
+        } else {
+            const char* piece = pieces[rand() % (PIECE_COUNT - 1)];
+            len += snprintf(p->text + len, MAX_LEN - len, "/%s", piece);
+            shape_len += snprintf(p->shape + shape_len, MAX_LEN - shape_len, "/%s", piece);
+        }
+    }
+}
+
+static void random_url(const Pattern* patterns, char* url)
+{
+    int len = 0;
+    // Fill the parameters of a pattern or make up a url
+    if (rand() % 4 != 0) {
+        const char* p = patterns[rand() % PATTERNS].text;
+        while (*p != '\0') {
+            if (*p == ':') {
+                while (*p != '\0' && *p != '/')
+                    p++;
+                len += snprintf(url + len, MAX_LEN - len, "%s", pieces[rand() % PIECE_COUNT]);
+                continue;
+            }
+            url[len++] = *p++;
+        }
+        url[len] = '\0';
+        if (rand() % 8 == 0)
+            len += snprintf(url + len, MAX_LEN - len, "/");
+        return;
+    }
+    int segments = rand() % 5;
+    for (int i = 0; i < segments; i++)
+        len += snprintf(url + len, MAX_LEN - len, "/%s", pieces[rand() % PIECE_COUNT]);
+    url[len] = '\0';
+}
+
+static int split(const char* s, StringSlice* segments)
+{
+    int count = 0;
+    const char* start = s;
+    for (const char* c = s;; c++) {
+        if (*c == '/' || *c == '\0') {
+            if (count < MAX_SEGMENTS) {
+                segments[count].chars = start;
+                segments[count].len = (int)(c - start);
+            }
+            count++;
+            start = c + 1;
+        }
+        if (*c == '\0')
+            break;
+    }
+    return count;
+}
+
+static bool is_param(const StringSlice* s)
+{
+    return s->len > 0 && s->chars[0] == ':';
+}
+
+/**
+ * @brief match url segment by segment
+ *
+ * @return amount of segments or -1 if the pattern doesn't match
+ */
+static int reference_match(const Pattern* p, const char* url, StringSlice* segments, StringSlice* url_segments)
+{
+    int count = split(p->text, segments);
+    if (split(url, url_segments) != count || count > MAX_SEGMENTS)
+        return -1;
+    for (int i = 0; i < count; i++) {
+        if (is_param(&segments[i])) {
+            if (url_segments[i].len == 0)
+                return -1;
+        } else if (segments[i].len != url_segments[i].len
+            || memcmp(segments[i].chars, url_segments[i].chars, segments[i].len) != 0) {
+            return -1;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief the route the router must pick: static segments win over
+ * parameters at the first segment where the matching patterns differ,
+ * and a later pattern with the same shape replaces an earlier one
+ *
+ * @return index of the pattern or -1
+ */
+static int reference_route(const Pattern* patterns, const char* url, StringSlice* params)
+{
+    int best = -1;
+    StringSlice best_segments[MAX_SEGMENTS];
+    StringSlice segments[MAX_SEGMENTS];
+    StringSlice url_segments[MAX_SEGMENTS];
+    int count = 0;
+    for (int i = 0; i < PATTERNS; i++) {
+        int n = reference_match(&patterns[i], url, segments, url_segments);
+        if (n < 0)
+            continue;
+        bool better = best == -1 || strcmp(patterns[i].shape, patterns[best].shape) == 0;
+        for (int j = 0; best != -1 && !better && j < n; j++) {
+            if (is_param(&segments[j]) != is_param(&best_segments[j])) {
+                better = !is_param(&segments[j]);
+                break;
+            }
+        }
+        if (better) {
+            best = i;
+            count = n;
+            memcpy(best_segments, segments, sizeof(segments));
+        }
+    }
+    int param = 0;
+    for (int j = 0; best != -1 && j < count; j++) {
+        if (is_param(&best_segments[j]))
+            params[param++] = url_segments[j];
+    }
+    return best;
+}
+
+int main(int argc, char const* argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    unsigned seed = argc > 2 ? (unsigned)atoi(argv[2]) : 1;
+    srand(seed);
+
+    Pattern patterns[PATTERNS];
+    long checked = 0;
+    for (int it = 0; it < iterations; it++) {
+        Router router;
+        init_router(&router);
+        for (int i = 0; i < PATTERNS; i++) {
+            random_pattern(&patterns[i]);
+            router_add(&router, patterns[i].text, &patterns[i]);
+        }
+
+        for (int u = 0; u < URLS; u++) {
+            char url[MAX_LEN * 2];
+            random_url(patterns, url);
+            StringSlice params[MAX_SEGMENTS];
+            StringSlice expected_params[MAX_SEGMENTS];
+            Pattern* got = router_match(&router, url, (int)strlen(url), params, MAX_SEGMENTS);
+            int expected = reference_route(patterns, url, expected_params);
+            bool ok = expected == -1 ? got == NULL : got == &patterns[expected];
+            for (int i = 0; ok && got != NULL && i < got->params; i++) {
+                ok = params[i].chars == expected_params[i].chars
+                    && params[i].len == expected_params[i].len;
+            }
+            if (!ok) {
+                printf("seed %u iteration %d: url \"%s\" matched \"%s\", expected \"%s\"\n",
+                    seed, it, url, got != NULL ? got->text : "(none)",
+                    expected != -1 ? patterns[expected].text : "(none)");
+                return EXIT_FAILURE;
+            }
+            checked++;
+        }
+        free_router(&router);
+    }
+    printf("%ld urls matched the reference\n", checked);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+#include "../src/datatypes.h"
+#include "../src/utils/arena.h"
+#include "../src/utils/json.h"
+#include <check.h>
+#include <pthread.h>
+#include <string.h>
+
+START_TEST(arena_alloc_t)
+{
+    Arena arena;
+    init_arena(&arena, 256);
+    char* a = arena_alloc(&arena, 10);
+    char* b = arena_alloc(&arena, 10);
+    ck_assert_int_eq((b - a) % ARENA_ALIGNMENT, 0);
+    ck_assert_int_eq(arena_owns(&arena, a), true);
+    // Newest allocation grows in place, older ones are copied
+    memcpy(b, "123456789", 10);
+    ck_assert_ptr_eq(arena_realloc(&arena, b, 10, 100), b);
+    memcpy(a, "abcdefghi", 10);
+    char* c = arena_realloc(&arena, a, 10, 40);
+    ck_assert_ptr_ne(c, a);
+    ck_assert_str_eq(c, "abcdefghi");
+    // Larger than a block
+    char* big = arena_alloc(&arena, 1000);
+    ck_assert_int_eq(arena_owns(&arena, big), true);
+    int stack = 0;
+    ck_assert_int_eq(arena_owns(&arena, &stack), false);
+    arena_reset(&arena);
+    ck_assert_int_eq(arena_owns(&arena, big), false);
+    ck_assert_ptr_eq(arena_alloc(&arena, 10), a);
+    free_arena(&arena);
+}
+END_TEST
+
+START_TEST(arena_reuse_t)
+{
+    Arena arena;
+    init_arena(&arena, 256);
+    // Spills over to more blocks, one of them large
+    char* first = arena_alloc(&arena, 200);
+    char* second = arena_alloc(&arena, 200);
+    char* large = arena_alloc(&arena, 1000);
+    size_t total = arena.total_size;
+    arena_reset(&arena);
+    ck_assert_int_eq(arena_owns(&arena, first), false);
+    // Same requests again get the same blocks without new ones
+    ck_assert_ptr_eq(arena_alloc(&arena, 200), first);
+    ck_assert_ptr_eq(arena_alloc(&arena, 200), second);
+    ck_assert_ptr_eq(arena_alloc(&arena, 1000), large);
+    ck_assert_int_eq(arena.total_size, total);
+    ck_assert_int_eq(arena_owns(&arena, first), true);
+    // Blocks past the limit are freed on reset
+    arena_alloc(&arena, ARENA_KEEP_BLOCKS * 256);
+    arena_reset(&arena);
+    ck_assert_int_le(arena.total_size, ARENA_KEEP_BLOCKS * 256);
+    free_arena(&arena);
+}
+END_TEST
+
+START_TEST(arena_memory_t)
+{
+    Arena arena;
+    init_arena(&arena, 1024);
+    Allocator allocator;
+    init_arena_allocator(&allocator, &arena);
+    // Allocated before the arena is used, stays on the heap
+    String* before = copy_chars("before", 6);
+    ck_assert_ptr_null(memory_use_allocator(&allocator));
+    char json[] = "{\"name\": \"sample\", \"list\": [1, 2, 3]}";
+    String* jstring = copy_chars(json, (int)strlen(json));
+    ck_assert_int_eq(arena_owns(&arena, jstring), true);
+    bool success = false;
+    JSONObject* obj = parse_json(jstring, &success);
+    ck_assert_int_eq(success, true);
+    String* name = json_get_string_c(obj, "name");
+    ck_assert_str_eq(name->chars, "sample");
+    // Elements are allocated between the growths of the array
+    JSONArray* list = json_get_array_c(obj, "list");
+    ck_assert_int_eq(list->length, 3);
+    for (int i = 0; i < list->length; i++)
+        ck_assert_int_eq((int)*AS_NUMBER(list->values[i]), i + 1);
+    JSONString* out = json_to_string(obj);
+    ck_assert_int_eq(strstr(out->chars, "[1,2,3]") != NULL, true);
+    STRINGP_FREE(out);
+    string_append_chars(before, " and after", 10);
+    ck_assert_int_eq(arena_owns(&arena, before->chars), false);
+    free_json(obj);
+    STRINGP_FREE(name);
+    STRINGP_FREE(jstring);
+    ck_assert_ptr_eq(memory_use_allocator(NULL), &allocator);
+    arena_reset(&arena);
+    ck_assert_str_eq(before->chars, "before and after");
+    STRINGP_FREE(before);
+    free_arena(&arena);
+}
+END_TEST
+
+#define COUNTING_MAX_BLOCKS 16
+
+typedef struct {
+    int allocations;
+    int frees;
+    void* blocks[COUNTING_MAX_BLOCKS];
+} CountingHeap;
+
+static void* counting_reallocate(void* ctx, void* previous, size_t old_size, size_t new_size)
+{
+    CountingHeap* heap = ctx;
+    void* ptr = heap_allocator.reallocate(NULL, previous, old_size, new_size);
+    if (new_size == 0)
+        heap->frees++;
+    else if (previous == NULL)
+        heap->allocations++;
+    for (int i = 0; i < COUNTING_MAX_BLOCKS; i++) {
+        if (heap->blocks[i] == previous) {
+            heap->blocks[i] = ptr;
+            break;
+        }
+    }
+    return ptr;
+}
+
+static bool counting_owns(void* ctx, const void* ptr)
+{
+    CountingHeap* heap = ctx;
+    for (int i = 0; i < COUNTING_MAX_BLOCKS; i++) {
+        if (heap->blocks[i] == ptr)
+            return true;
+    }
+    return false;
+}
+
+START_TEST(allocator_stack_t)
+{
+    CountingHeap heap = { 0 };
+    Allocator counting = { counting_reallocate, counting_owns, &heap };
+    // Headers kept by the pool of the thread would not be counted
+    pool_trim();
+    // Long enough for separate chars
+    const char* thread = "allocated with the thread allocator";
+    String* before = copy_chars(thread, (int)strlen(thread));
+    // Allocators that can't tell their memory apart are not used
+    Allocator unowned = { counting_reallocate, NULL, &heap };
+    ck_assert_ptr_null(memory_use_thread_allocator(&unowned));
+    ck_assert_ptr_null(memory_use_thread_allocator(&counting));
+    String* str = copy_chars(thread, (int)strlen(thread));
+    ck_assert_int_eq(heap.allocations, 2);
+    // Memory from before goes back to the default allocator
+    STRINGP_FREE(before);
+    pool_trim();
+    ck_assert_int_eq(heap.frees, 0);
+
+    Arena arena;
+    init_arena(&arena, 1024);
+    Allocator allocator;
+    init_arena_allocator(&allocator, &arena);
+    memory_use_allocator(&allocator);
+    String* request_str = copy_chars("request", 7);
+    ck_assert_int_eq(arena_owns(&arena, request_str), true);
+    ck_assert_int_eq(heap.allocations, 2);
+    // Freed by the allocator it came from.
+    // The String header is kept by the pool
+    STRINGP_FREE(str);
+    ck_assert_int_eq(heap.frees, 1);
+    STRINGP_FREE(request_str);
+    ck_assert_int_eq(heap.frees, 1);
+    // and never the ones of the arena
+    pool_trim();
+    ck_assert_int_eq(heap.frees, 2);
+    memory_use_allocator(NULL);
+    free_arena(&arena);
+
+    ck_assert_ptr_eq(memory_use_thread_allocator(NULL), &counting);
+    str = copy_chars("default", 7);
+    ck_assert_int_eq(heap.allocations, 2);
+    STRINGP_FREE(str);
+}
+END_TEST
+
+START_TEST(pool_t)
+{
+    pool_trim();
+    String* a = POOL_ALLOCATE(String);
+    POOL_FREE(String, a);
+    // Reused by the next object of the same size class
+    ck_assert_ptr_eq(POOL_ALLOCATE(String), a);
+    JSONNumber* number = POOL_ALLOCATE(JSONNumber);
+    POOL_FREE(JSONNumber, number);
+    ck_assert_ptr_eq(POOL_ALLOCATE(JSONBool), (JSONBool*)number);
+    POOL_FREE(JSONBool, number);
+
+    // Cells of numbers and bools are freed and copied with the objects
+    JSONObject* obj = POOL_ALLOCATE(JSONObject);
+    init_json(obj);
+    json_add_number_c(obj, "number", 12);
+    json_add_bool_c(obj, "bool", true);
+    table_set(obj, copy_chars("macro_number", 12), NUMBER_VAL("2.5"));
+    table_set(obj, copy_chars("macro_bool", 10), BOOL_VAL(false));
+    ck_assert_int_eq(*json_get_bool_c(obj, "macro_bool"), false);
+    ck_assert_int_eq((int)(*json_get_number_c(obj, "macro_number") * 2), 5);
+    JSONObject* copy = copy_table(obj);
+    ck_assert_ptr_ne(json_get_number_c(copy, "number"), json_get_number_c(obj, "number"));
+    ck_assert_int_eq((int)*json_get_number_c(copy, "number"), 12);
+    ck_assert_int_eq(*json_get_bool_c(copy, "bool"), true);
+    free_json(obj);
+    free_json(copy);
+    POOL_FREE(String, a);
+
+    // Objects of the request allocator are left to it
+    Arena arena;
+    init_arena(&arena, 1024);
+    Allocator allocator;
+    init_arena_allocator(&allocator, &arena);
+    memory_use_allocator(&allocator);
+    String* request_str = POOL_ALLOCATE(String);
+    ck_assert_int_eq(arena_owns(&arena, request_str), true);
+    POOL_FREE(String, request_str);
+    memory_use_allocator(NULL);
+    String* str = POOL_ALLOCATE(String);
+    ck_assert_int_eq(arena_owns(&arena, str), false);
+    POOL_FREE(String, str);
+    free_arena(&arena);
+    pool_trim();
+}
+END_TEST
+
+static void* pool_thread(void* allocator)
+{
+    memory_use_thread_allocator(allocator);
+    POOL_FREE(String, POOL_ALLOCATE(String));
+    POOL_FREE(JSONNumber, POOL_ALLOCATE(JSONNumber));
+    return NULL;
+}
+
+START_TEST(pool_thread_exit_t)
+{
+    CountingHeap heap = { 0 };
+    // Still in use after the thread function returns
+    Allocator counting = { counting_reallocate, counting_owns, &heap };
+    pthread_t thread;
+    ck_assert_int_eq(pthread_create(&thread, NULL, pool_thread, &counting), 0);
+    pthread_join(thread, NULL);
+    // Objects kept by the thread are freed when it exits
+    ck_assert_int_eq(heap.allocations, 2);
+    ck_assert_int_eq(heap.frees, 2);
+}
+END_TEST
+
+Suite* arena_suite()
+{
+    Suite* s;
+    TCase* tc_core;
+
+    s = suite_create("Arena");
+
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, arena_alloc_t);
+    tcase_add_test(tc_core, arena_reuse_t);
+    tcase_add_test(tc_core, arena_memory_t);
+    tcase_add_test(tc_core, allocator_stack_t);
+    tcase_add_test(tc_core, pool_t);
+    tcase_add_test(tc_core, pool_thread_exit_t);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main()
+{
+    int number_failed;
+    Suite* s;
+    SRunner* sr;
+
+    s = arena_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
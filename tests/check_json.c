@@ -1,5 +1,6 @@
 #include "../src/utils/json.h"
 #include <check.h>
+#include <math.h>
 
 START_TEST(simple_json_parse_t)
 {
@@ -278,6 +279,111 @@ START_TEST(json_add_to_obj_obj_t)
 }
 END_TEST
 
+static void json_writer_append(void* ctx, const char* chars, int len)
+{
+    string_append_chars((String*)ctx, chars, len);
+}
+
+START_TEST(json_writer_t)
+{
+    String out;
+    STRING_INIT(&out);
+    JSONWriter w;
+    json_writer_init(&w, json_writer_append, &out);
+    json_writer_begin_object(&w);
+    json_writer_key(&w, "array");
+    json_writer_begin_array(&w);
+    json_writer_string(&w, "a\"b\\\n", 5);
+    json_writer_number(&w, 2);
+    json_writer_bool(&w, false);
+    json_writer_null(&w);
+    json_writer_begin_object(&w);
+    json_writer_end_object(&w);
+    json_writer_end_array(&w);
+    json_writer_key(&w, "obj");
+    json_writer_begin_object(&w);
+    json_writer_key(&w, "n");
+    json_writer_number(&w, 3);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    const char expected[] = "{\"array\":[\"a\\\"b\\\\\\n\",2,false,null,{}],\"obj\":{\"n\":3}}";
+    ck_assert_int_eq(out.len, (int)strlen(expected));
+    ck_assert_int_eq(strncmp(out.chars, expected, out.len), 0);
+    STRING_FREE(&out);
+}
+END_TEST
+
+START_TEST(json_writer_depth_t)
+{
+    String out;
+    STRING_INIT(&out);
+    JSONWriter w;
+    json_writer_init(&w, json_writer_append, &out);
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++)
+        json_writer_begin_array(&w);
+    ck_assert_int_eq(w.failed, false);
+    json_writer_begin_object(&w);
+    ck_assert_int_eq(w.failed, true);
+    // Nothing is written after the refused container
+    json_writer_number(&w, 1);
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++)
+        json_writer_end_array(&w);
+    ck_assert_int_eq(out.len, JSON_WRITER_MAX_DEPTH);
+    for (int i = 0; i < out.len; i++)
+        ck_assert_int_eq(out.chars[i], '[');
+    STRING_FREE(&out);
+}
+END_TEST
+
+START_TEST(json_writer_number_t)
+{
+    String out;
+    STRING_INIT(&out);
+    JSONWriter w;
+    json_writer_init(&w, json_writer_append, &out);
+    json_writer_begin_array(&w);
+    json_writer_number(&w, 16777216);
+    json_writer_number(&w, 0.5f);
+    json_writer_number(&w, -3);
+    const char expected[] = "[16777216,0.5,-3";
+    ck_assert_int_eq(out.len, (int)strlen(expected));
+    ck_assert_int_eq(strncmp(out.chars, expected, out.len), 0);
+    // JSON has no NaN
+    json_writer_number(&w, NAN);
+    ck_assert_int_eq(w.failed, true);
+    json_writer_end_array(&w);
+    ck_assert_int_eq(out.len, (int)strlen(expected));
+    STRING_FREE(&out);
+}
+END_TEST
+
+START_TEST(small_string_t)
+{
+    String* key = copy_chars("name", 4);
+    ck_assert_int_eq(STRING_IS_INLINE(key), true);
+    ck_assert_str_eq(key->chars, "name");
+    String* copy = copy_string(key);
+    ck_assert_int_eq(STRING_IS_INLINE(copy), true);
+    ck_assert_int_eq(copy->hash, key->hash);
+    // Grows out of the String once the chars don't fit
+    for (int i = key->len; i <= STRING_INLINE_CAPACITY; i++)
+        STRING_APPEND(key, 'x');
+    ck_assert_int_eq(STRING_IS_INLINE(key), false);
+    ck_assert_int_eq(key->len, STRING_INLINE_CAPACITY + 1);
+    ck_assert_int_eq(strncmp(key->chars, "namexxxx", 8), 0);
+    ck_assert_int_eq(key->chars[key->len], '\0');
+    string_append_chars(copy, "-with-a-longer-suffix", 21);
+    ck_assert_int_eq(STRING_IS_INLINE(copy), false);
+    ck_assert_str_eq(copy->chars, "name-with-a-longer-suffix");
+    String* long_str = copy_chars(copy->chars, copy->len);
+    ck_assert_int_eq(STRING_IS_INLINE(long_str), false);
+    ck_assert_str_eq(long_str->chars, copy->chars);
+    STRINGP_FREE(key);
+    STRINGP_FREE(copy);
+    STRINGP_FREE(long_str);
+}
+END_TEST
+
 Suite* json_suite()
 {
     Suite* s;
@@ -298,6 +404,10 @@ Suite* json_suite()
     tcase_add_test(tc_core, json_kw_array_len1_t);
     tcase_add_test(tc_core, json_kw_array_len5_t);
     tcase_add_test(tc_core, json_to_string_t);
+    tcase_add_test(tc_core, json_writer_t);
+    tcase_add_test(tc_core, json_writer_depth_t);
+    tcase_add_test(tc_core, json_writer_number_t);
+    tcase_add_test(tc_core, small_string_t);
     tcase_add_test(tc_core, json_add_to_obj_basic_t);
     tcase_add_test(tc_core, json_add_to_obj_array_t);
     tcase_add_test(tc_core, json_add_to_obj_obj_t);
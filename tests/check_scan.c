@@ -0,0 +1,123 @@
+#include "../src/utils/scan.h"
+#include <check.h>
+#include <string.h>
+
+static const ScanImpl impls[] = { SCAN_SCALAR, SCAN_SSE42, SCAN_AVX2 };
+static const char* const impl_names[] = { "scalar", "sse4.2", "avx2" };
+#define IMPL_COUNT (int)(sizeof(impls) / sizeof(impls[0]))
+
+typedef struct {
+    const char* s;
+    const char* set;
+    int expected;
+} FindAnyCase;
+
+static const FindAnyCase cases[] = {
+    { "", "?", 0 },
+    { "a", "a", 0 },
+    { "/users/:id", ":", 7 },
+    { "/users/:id", "?#", 10 },
+    { "key=value&other", "=&", 3 },
+    // Tails shorter than a vector
+    { "abcde", "e", 4 },
+    { "0123456789abcdefX", "X", 16 },
+    { "0123456789abcdef0123456789abcdefX", "X", 32 },
+    { "0123456789abcdef0123456789abcdef0123456789abcdefX", "XY", 48 },
+    // Matches at the last byte of the first vectors
+    { "0123456789abcdeX", "X", 15 },
+    { "0123456789abcdef0123456789abcdeX", "X", 31 },
+    // First of several matches in a vector
+    { "0123456789abcdef0123X5678Y", "YX", 20 },
+    // Bytes over 0x7f
+    { "plain\xc3\xa4 text \xff", "\xff", 13 },
+    // Full set
+    { "the quick brown fox jumps over the lazy dog", "0123456789ABCDEz", 37 },
+    { "the quick brown fox jumps over the lazy dog", "0123456789ABCDEF", 43 },
+};
+#define CASE_COUNT (int)(sizeof(cases) / sizeof(cases[0]))
+
+START_TEST(find_any_table_t)
+{
+    for (int i = 0; i < IMPL_COUNT; i++) {
+        if (!scan_use(impls[i]))
+            continue;
+        for (int j = 0; j < CASE_COUNT; j++) {
+            const FindAnyCase* c = &cases[j];
+            int found = scan_find_any(c->s, (int)strlen(c->s), c->set, (int)strlen(c->set));
+            ck_assert_msg(found == c->expected, "%s: \"%s\" in \"%s\" found at %d, expected %d",
+                impl_names[i], c->set, c->s, found, c->expected);
+        }
+    }
+    scan_use(SCAN_AUTO);
+}
+END_TEST
+
+START_TEST(find_any_boundaries_t)
+{
+    // Every length and every match position across three AVX2 vectors
+    char buf[100];
+    memset(buf, 'a', sizeof(buf));
+    for (int i = 0; i < IMPL_COUNT; i++) {
+        if (!scan_use(impls[i]))
+            continue;
+        for (int len = 0; len <= 96; len++) {
+            ck_assert_int_eq(scan_find_any(buf, len, "/?", 2), len);
+            for (int at = 0; at < len; at++) {
+                buf[at] = '?';
+                // A match just past len is not found
+                buf[len] = '/';
+                int found = scan_find_any(buf, len, "/?", 2);
+                buf[at] = 'a';
+                buf[len] = 'a';
+                ck_assert_msg(found == at, "%s: length %d found at %d, expected %d",
+                    impl_names[i], len, found, at);
+            }
+        }
+    }
+    scan_use(SCAN_AUTO);
+}
+END_TEST
+
+START_TEST(find_any_set_t)
+{
+    // Empty sets find nothing and sets are cut to SCAN_SET_SIZE
+    ck_assert_int_eq(scan_find_any("abc", 3, "a", 0), 3);
+    ck_assert_int_eq(scan_find_any("xyz", 3, "abcdefghijklmnopz", 17), 3);
+    ck_assert_int_eq(scan_find_any("xyp", 3, "abcdefghijklmnopz", 17), 2);
+    ck_assert_int_eq(scan_use(SCAN_SCALAR), true);
+    ck_assert_int_eq(scan_use(SCAN_AUTO), true);
+}
+END_TEST
+
+Suite* scan_suite(void)
+{
+    Suite* s;
+    TCase* tc_core;
+
+    s = suite_create("Scan");
+
+    tc_core = tcase_create("Core");
+
+    tcase_add_test(tc_core, find_any_table_t);
+    tcase_add_test(tc_core, find_any_boundaries_t);
+    tcase_add_test(tc_core, find_any_set_t);
+
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
+
+int main()
+{
+    int number_failed;
+    Suite* s;
+    SRunner* sr;
+
+    s = scan_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -247,18 +247,18 @@ String* global_parameter_string3 = NULL;
 #include <stdio.h>
 void parameter_api_id_fun(Response* r, Request* test)
 {
-    global_parameter_string1 = json_get_string_c(test->params, "id");
+    global_parameter_string1 = json_get_string_c(request_params(test), "id");
 }
 void parameter_api_id_pos_fun(Response* r, Request* test)
 {
-    global_parameter_string1 = json_get_string_c(test->params, "id");
-    global_parameter_string2 = json_get_string_c(test->params, "pos");
+    global_parameter_string1 = json_get_string_c(request_params(test), "id");
+    global_parameter_string2 = json_get_string_c(request_params(test), "pos");
 }
 void parameter_endpoint_id_fun(Response* r, Request* test)
 {
-    global_parameter_string1 = json_get_string_c(test->params, "id");
-    global_parameter_string2 = json_get_string_c(test->params, "pos");
-    global_parameter_string3 = json_get_string_c(test->params, "end");
+    global_parameter_string1 = json_get_string_c(request_params(test), "id");
+    global_parameter_string2 = json_get_string_c(request_params(test), "pos");
+    global_parameter_string3 = json_get_string_c(request_params(test), "end");
 }
 
 START_TEST(parameter_rest_callback_t)
@@ -267,20 +267,19 @@ START_TEST(parameter_rest_callback_t)
     init_server(&rs);
     add_url(&rs, "/api/:id", parameter_api_id_fun);
     String* url = copy_chars("/api/123", strlen("/api/123"));
-    ApiUrl* au = get_call_back(&rs, url);
     Request r;
     init_request(&r);
     r.uri = *url;
-    parse_paramas(&r, au);
+    unsigned allowed;
+    ApiUrl* au = get_request_call_back(&rs, &r, &allowed);
     (au->callback)(NULL, &r);
     ck_assert_str_eq(global_parameter_string1->chars, "123");
     STRINGP_FREE(url);
     STRINGP_FREE(global_parameter_string1);
     add_url(&rs, "/api/:id/:pos", parameter_api_id_pos_fun);
     url = copy_chars("/api/321/name", strlen("/api/321/name"));
-    au = get_call_back(&rs, url);
     r.uri = *url;
-    parse_paramas(&r, au);
+    au = get_request_call_back(&rs, &r, &allowed);
     (au->callback)(NULL, &r);
     ck_assert_str_eq(global_parameter_string1->chars, "321");
     ck_assert_str_eq(global_parameter_string2->chars, "name");
@@ -289,9 +288,8 @@ START_TEST(parameter_rest_callback_t)
     STRINGP_FREE(global_parameter_string2);
     add_url(&rs, "/endpoint/:id/:pos/:end", parameter_endpoint_id_fun);
     url = copy_chars("/endpoint/name/end/len", strlen("/endpoint/name/end/len"));
-    au = get_call_back(&rs, url);
     r.uri = *url;
-    parse_paramas(&r, au);
+    au = get_request_call_back(&rs, &r, &allowed);
     (au->callback)(NULL, &r);
     ck_assert_str_eq(global_parameter_string1->chars, "name");
     ck_assert_str_eq(global_parameter_string2->chars, "end");
@@ -303,6 +301,161 @@ START_TEST(parameter_rest_callback_t)
 }
 END_TEST
 
+void method_get_fun(Response* r, Request* test)
+{
+    simple_global_int = GET;
+}
+void method_post_fun(Response* r, Request* test)
+{
+    simple_global_int = POST;
+}
+void method_any_fun(Response* r, Request* test)
+{
+    simple_global_int = 0;
+}
+
+START_TEST(method_rest_callback_t)
+{
+    RestServer rs;
+    init_server(&rs);
+    add_get(&rs, "/item/:id", method_get_fun);
+    add_post(&rs, "/item/:id", method_post_fun);
+    add_url(&rs, "/any", method_any_fun);
+    add_get(&rs, "/any", method_get_fun);
+    String* url = copy_chars("/item/1", strlen("/item/1"));
+    unsigned allowed;
+    ApiUrl* au = get_method_call_back(&rs, GET, url, &allowed);
+    (au->callback)(NULL, NULL);
+    ck_assert_int_eq(simple_global_int, GET);
+    au = get_method_call_back(&rs, POST, url, &allowed);
+    (au->callback)(NULL, NULL);
+    ck_assert_int_eq(simple_global_int, POST);
+    au = get_method_call_back(&rs, PUT, url, &allowed);
+    ck_assert_ptr_null(au);
+    ck_assert_int_eq(allowed, (1u << GET) | (1u << POST));
+    // add_url isn't in the method tables
+    ck_assert_ptr_null(get_call_back(&rs, url));
+    STRINGP_FREE(url);
+    // Method url comes before add_url
+    url = copy_chars("/any", strlen("/any"));
+    au = get_method_call_back(&rs, GET, url, &allowed);
+    (au->callback)(NULL, NULL);
+    ck_assert_int_eq(simple_global_int, GET);
+    au = get_method_call_back(&rs, DELETE, url, &allowed);
+    (au->callback)(NULL, NULL);
+    ck_assert_int_eq(simple_global_int, 0);
+    STRINGP_FREE(url);
+    url = copy_chars("/none", strlen("/none"));
+    au = get_method_call_back(&rs, GET, url, &allowed);
+    ck_assert_ptr_null(au);
+    ck_assert_int_eq(allowed, 0);
+    STRINGP_FREE(url);
+}
+END_TEST
+
+START_TEST(path_param_spill_t)
+{
+    RestServer rs;
+    init_server(&rs);
+    add_url(&rs, "/:a/:b/:c/:d/:e/:f/:g/:h/:i/:j", simple_rest_callback_fun);
+    add_url(&rs, "/x/:id", simple_rest_callback_fun);
+    Request r;
+    init_request(&r);
+    unsigned allowed;
+    string_append_chars(&r.uri, "/x/42", 5);
+    get_request_call_back(&rs, &r, &allowed);
+    ck_assert_ptr_null(r.path_params_spill);
+    ck_assert_int_eq(request_param(&r, "id")->len, 2);
+    ck_assert_ptr_null(request_param(&r, "i"));
+    STRING_FREE(&r.uri);
+    STRING_INIT(&r.uri);
+    const char* url = "/1/2/3/4/5/6/7/8/9/10";
+    string_append_chars(&r.uri, url, (int)strlen(url));
+    get_request_call_back(&rs, &r, &allowed);
+    ck_assert_int_eq(r.path_param_count, 10);
+    const StringSlice* j = request_param(&r, "j");
+    ck_assert_int_eq(strncmp(j->chars, "10", j->len), 0);
+    String* i = json_get_string_c(request_params(&r), "i");
+    ck_assert_str_eq(i->chars, "9");
+    STRINGP_FREE(i);
+    // Url added again frees the previous route and its keywords
+    add_url(&rs, "/x/:key", parameter_api_id_fun);
+    STRING_FREE(&r.uri);
+    STRING_INIT(&r.uri);
+    string_append_chars(&r.uri, "/x/7", 4);
+    ApiUrl* au = get_request_call_back(&rs, &r, &allowed);
+    ck_assert_ptr_eq(au->callback, parameter_api_id_fun);
+    ck_assert_ptr_null(request_param(&r, "id"));
+    ck_assert_int_eq(request_param(&r, "key")->len, 1);
+    free_request(&r);
+}
+END_TEST
+
+START_TEST(query_string_t)
+{
+    const char* message = "GET /search/x?q=a%20b&&flag&name=c+d&%71=2&bad=%2 HTTP/1.1\r\n\r\n";
+    String* m = copy_chars(message, (int)strlen(message));
+    Request r;
+    init_request(&r);
+    parse_request_message(&r, m);
+    ck_assert_str_eq(r.uri.chars, "/search/x");
+    ck_assert_int_eq(r.uri.len, 9);
+    char buf[16];
+    ck_assert_int_eq(request_query(&r, "q", buf, sizeof(buf)), 3);
+    ck_assert_str_eq(buf, "a b");
+    ck_assert_int_eq(request_query(&r, "flag", buf, sizeof(buf)), 0);
+    ck_assert_int_eq(request_query(&r, "name", buf, sizeof(buf)), 3);
+    ck_assert_str_eq(buf, "c d");
+    ck_assert_int_eq(request_query(&r, "bad", buf, sizeof(buf)), 2);
+    ck_assert_str_eq(buf, "%2");
+    ck_assert_int_eq(request_query(&r, "missing", buf, sizeof(buf)), -1);
+    ck_assert_int_eq(request_query(&r, "q", buf, 3), -1);
+    // Names are decoded too, the first q wins
+    ck_assert_int_eq(request_query(&r, "q", buf, sizeof(buf)), 3);
+    QueryIterator it;
+    StringSlice name;
+    StringSlice value;
+    int pairs = 0;
+    request_query_iterator(&r, &it);
+    while (query_next(&it, &name, &value))
+        pairs++;
+    ck_assert_int_eq(pairs, 5);
+    free_request(&r);
+    STRINGP_FREE(m);
+}
+END_TEST
+
+START_TEST(router_priority_t)
+{
+    Router router;
+    init_router(&router);
+    int me = 1, id = 2, posts = 3, static_posts = 4;
+    ck_assert_ptr_null(router_add(&router, "/user/:id", &me));
+    // Adding again returns the replaced value
+    ck_assert_ptr_eq(router_add(&router, "/user/:name", &id), &me);
+    router_add(&router, "/user/me", &me);
+    router_add(&router, "/user/:id/posts/:post", &posts);
+    router_add(&router, "/user/me/settings", &static_posts);
+    ck_assert_int_eq(router.count, 4);
+    StringSlice params[2];
+    const char* url = "/user/me";
+    ck_assert_ptr_eq(router_match(&router, url, (int)strlen(url), params, 2), &me);
+    url = "/user/mel";
+    ck_assert_ptr_eq(router_match(&router, url, (int)strlen(url), params, 2), &id);
+    ck_assert_int_eq(params[0].len, 3);
+    // Static "me" doesn't lead to posts so the parameter is tried
+    url = "/user/me/posts/12";
+    ck_assert_ptr_eq(router_match(&router, url, (int)strlen(url), params, 2), &posts);
+    ck_assert_int_eq(strncmp(params[0].chars, "me", params[0].len), 0);
+    ck_assert_int_eq(strncmp(params[1].chars, "12", params[1].len), 0);
+    url = "/user/";
+    ck_assert_ptr_null(router_match(&router, url, (int)strlen(url), params, 2));
+    url = "/user/me/settingsx";
+    ck_assert_ptr_null(router_match(&router, url, (int)strlen(url), params, 2));
+    free_router(&router);
+}
+END_TEST
+
 Suite* server_suite()
 {
     Suite* s;
@@ -315,6 +468,10 @@ Suite* server_suite()
     tcase_add_test(tc_core, simple_rest_callback_t);
     tcase_add_test(tc_core, stress_rest_callback_t);
     tcase_add_test(tc_core, parameter_rest_callback_t);
+    tcase_add_test(tc_core, method_rest_callback_t);
+    tcase_add_test(tc_core, router_priority_t);
+    tcase_add_test(tc_core, path_param_spill_t);
+    tcase_add_test(tc_core, query_string_t);
 
     suite_add_tcase(s, tc_core);
 
@@ -1,6 +1,8 @@
 
 #include "../../src/http.h"
 #include "../../src/server.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 void simple_callback(Response* res, Request* req)
@@ -16,7 +18,8 @@ void simple_callback(Response* res, Request* req)
 void data_callback(Response* res, Request* req)
 {
     bool success;
-    JSONObject* json_obj = parse_json(&req->content, &success);
+    JSONString* content = copy_chars(req->content.chars, req->content.len);
+    JSONObject* json_obj = parse_json(content, &success);
     char* json = NULL;
     if (success == false) {
         json = "{\"error\": \"Parse failed!\"}";
@@ -31,6 +34,7 @@ void data_callback(Response* res, Request* req)
         }
         STRINGP_FREE(tmp);
     }
+    STRINGP_FREE(content);
     JSONString* jstring = copy_chars(json, strlen(json));
     JSONObject* obj = parse_json(jstring, NULL);
     send_json(res, obj);
@@ -40,14 +44,14 @@ void data_callback(Response* res, Request* req)
 
 void parameter_callback(Response* res, Request* req)
 {
-    JSONString* json_str = json_get_string_c(req->params, "param");
+    const StringSlice* param = request_param(req, "param");
     char* json = NULL;
-    if (json_str == NULL) {
+    if (param == NULL) {
         json = "{\"error\": \"No 'param' parameter found!\"}";
     } else {
-        if (strcmp(json_str->chars, "1") == 0) {
+        if (param->len == 1 && param->chars[0] == '1') {
             json = "{\"result\": \"1\"}";
-        } else if (strcmp(json_str->chars, "2") == 0) {
+        } else if (param->len == 1 && param->chars[0] == '2') {
             json = "{\"result\": \"2\"}";
         } else {
             json = "{\"result\": \"not found\"}";
@@ -62,7 +66,102 @@ void parameter_callback(Response* res, Request* req)
 
 void return_request_params(Response* res, Request* req)
 {
-    send_json(res, req->params);
+    send_json(res, request_params(req));
+}
+
+void header_callback(Response* res, Request* req)
+{
+    char json[] = "{\"test\": \"header\"}";
+    JSONString* jstring = copy_chars(json, strlen(json));
+    JSONObject* obj = parse_json(jstring, NULL);
+    // Echo the header of the request
+    const StringSlice* value = request_header(req, "x-test");
+    char echo[64] = "header";
+    if (value != NULL && value->len < (int)sizeof(echo)) {
+        memcpy(echo, value->chars, value->len);
+        echo[value->len] = '\0';
+    }
+    response_add_header(res, "X-Test", echo);
+    send_json(res, obj);
+    free_json(obj);
+    STRINGP_FREE(jstring);
+}
+
+bool upload_part(Request* req, StringSlice part)
+{
+    // Upload was aborted
+    if (part.chars == NULL) {
+        free(req->user_data);
+        return false;
+    }
+    if (req->user_data == NULL)
+        req->user_data = calloc(1, sizeof(long));
+    *(long*)req->user_data += part.len;
+    return true;
+}
+
+void upload_callback(Response* res, Request* req)
+{
+    long size = req->user_data != NULL ? *(long*)req->user_data : 0;
+    free(req->user_data);
+    req->user_data = NULL;
+    char json[64];
+    snprintf(json, sizeof(json), "{\"size\": \"%ld\"}", size);
+    JSONString* jstring = copy_chars(json, strlen(json));
+    JSONObject* obj = parse_json(jstring, NULL);
+    send_json(res, obj);
+    free_json(obj);
+    STRINGP_FREE(jstring);
+}
+
+void stream_callback(Response* res, Request* req)
+{
+    const StringSlice* count_str = request_param(req, "count");
+    int count = 0;
+    for (int i = 0; count_str != NULL && i < count_str->len; i++)
+        count = count * 10 + count_str->chars[i] - '0';
+
+    JSONWriter w;
+    response_begin_json(res, &w);
+    json_writer_begin_array(&w);
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        int len = snprintf(name, sizeof(name), "item \"%d\"", i);
+        json_writer_begin_object(&w);
+        json_writer_key(&w, "i");
+        json_writer_number(&w, i);
+        json_writer_key(&w, "name");
+        json_writer_string(&w, name, len);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+    response_end(res);
+}
+
+void deep_callback(Response* res, Request* req)
+{
+    const StringSlice* depth_str = request_param(req, "depth");
+    int depth = 0;
+    for (int i = 0; depth_str != NULL && i < depth_str->len; i++)
+        depth = depth * 10 + depth_str->chars[i] - '0';
+
+    JSONWriter w;
+    response_begin_json(res, &w);
+    for (int i = 0; i < depth; i++)
+        json_writer_begin_array(&w);
+    json_writer_number(&w, depth);
+    for (int i = 0; i < depth; i++)
+        json_writer_end_array(&w);
+    response_end(res);
+}
+
+void method_callback(Response* res, Request* req)
+{
+    JSONObject* obj = ALLOCATE(JSONObject, 1);
+    init_json(obj);
+    json_add_string_c(obj, "method", request_type_name(req->type));
+    send_json(res, obj);
+    free_json(obj);
 }
 
 int main(int argc, char const* argv[])
@@ -70,9 +169,18 @@ int main(int argc, char const* argv[])
 
     RestServer rs;
     init_server(&rs);
+    set_server_option_gzip_json(0);
+    set_server_option_request_arena(16384);
+    set_server_option_max_body_size(65536);
     add_url(&rs, "/", simple_callback);
     add_url(&rs, "/api", data_callback);
     add_url(&rs, "/parameter/:param", parameter_callback);
     add_url(&rs, "/req/:num/:id", return_request_params);
+    add_url(&rs, "/header", header_callback);
+    add_url_streaming(&rs, "/upload", upload_callback, upload_part);
+    add_url(&rs, "/stream/:count", stream_callback);
+    add_url(&rs, "/deep/:depth", deep_callback);
+    add_get(&rs, "/method", method_callback);
+    add_post(&rs, "/method", method_callback);
     return run_server(&rs);
 }
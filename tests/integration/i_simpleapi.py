@@ -1,4 +1,8 @@
+import gzip
+import http.client
 import json
+import socket
+import time
 import unittest
 import urllib.request as re
 
@@ -36,6 +40,10 @@ class TestSimpleCallback(unittest.TestCase):
             self.assertNotIn('error', str(data))
             j = json.loads(data)
             self.assertEqual(j['result'], 'not found')
+        # Query string is not part of the routed path
+        req = re.Request(url=f"{server}/parameter/2?x=1&y=%20")
+        with re.urlopen(req) as f:
+            self.assertEqual(json.loads(f.read())['result'], '2')
 
     def test_data(self):
         req = re.Request(url=f"{server}/api", method='POST', data=b'{"tdata": "test1"}')
@@ -60,6 +68,31 @@ class TestSimpleCallback(unittest.TestCase):
             j = json.loads(data)
             self.assertEqual(j['result'], 'not found')
 
+    def test_chunked(self):
+        c = http.client.HTTPConnection("localhost", 8888)
+        body = iter([b'{"tdata"', b': "test2"}'])
+        # http.client sends iterables with chunked encoding
+        c.request("PUT", "/api", body=body)
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read())['result'], 'test2')
+        c.request("DELETE", "/api", body=b'{"tdata": "test1"}')
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read())['result'], 'test1')
+        c.close()
+
+    def test_upload(self):
+        c = http.client.HTTPConnection("localhost", 8888)
+        c.request("POST", "/upload", body=b'x' * 10000000)
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read())['size'], '10000000')
+        c.request("POST", "/upload", body=iter([b'y' * 1000000] * 5))
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read())['size'], '5000000')
+        c.request("POST", "/upload", body=b'small')
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read())['size'], '5')
+        c.close()
+
     def test_parameter_return(self):
         req = re.Request(url=f"{server}/req/test/123", method='POST', data=b'{"tdata": "test1"}')
         with re.urlopen(req) as f:
@@ -70,5 +103,150 @@ class TestSimpleCallback(unittest.TestCase):
             self.assertEqual(j['num'], 'test')
             self.assertEqual(j['id'], '123')
 
+    def test_header(self):
+        req = re.Request(url=f"{server}/header")
+        with re.urlopen(req) as f:
+            self.assertEqual(f.info()['X-Test'], 'header')
+            j = json.loads(f.read())
+            self.assertEqual(j['test'], 'header')
+        req = re.Request(url=f"{server}/header", headers={"x-TEST": "echo"})
+        with re.urlopen(req) as f:
+            self.assertEqual(f.info()['X-Test'], 'echo')
+
+    def test_gzip(self):
+        req = re.Request(url=f"{server}/", headers={"Accept-Encoding": "gzip"})
+        with re.urlopen(req) as f:
+            self.assertEqual(f.info()['Content-Encoding'], 'gzip')
+            j = json.loads(gzip.decompress(f.read()))
+            self.assertEqual(j['test'], 'callback')
+        req = re.Request(url=f"{server}/", headers={"Accept-Encoding": "gzip;q=0"})
+        with re.urlopen(req) as f:
+            self.assertEqual(f.info()['Content-Encoding'], None)
+            j = json.loads(f.read())
+            self.assertEqual(j['test'], 'callback')
+
+    def test_method(self):
+        c = http.client.HTTPConnection("localhost", 8888)
+        for method in ["GET", "POST"]:
+            c.request(method, "/method")
+            r = c.getresponse()
+            self.assertEqual(json.loads(r.read())['method'], method)
+        c.request("PUT", "/method", body=b'{}')
+        r = c.getresponse()
+        r.read()
+        self.assertEqual(r.status, 405)
+        self.assertEqual(r.getheader('Allow'), 'GET, POST')
+        c.close()
+
+    def test_stream(self):
+        c = http.client.HTTPConnection("localhost", 8888)
+        c.request("GET", "/stream/5000")
+        r = c.getresponse()
+        self.assertEqual(r.getheader('Transfer-Encoding'), 'chunked')
+        j = json.loads(r.read())
+        self.assertEqual(len(j), 5000)
+        self.assertEqual(j[4999], {'i': 4999, 'name': 'item "4999"'})
+        # Connection is reused after the last chunk
+        c.request("GET", "/stream/0")
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read()), [])
+        c.close()
+        # HTTP/1.0 clients get the body framed by closing the connection
+        with socket.create_connection(("localhost", 8888)) as s:
+            s.sendall(b"GET /stream/2 HTTP/1.0\r\n\r\n")
+            data = b''
+            while True:
+                part = s.recv(65536)
+                if not part:
+                    break
+                data += part
+        head, body = data.split(b'\r\n\r\n', 1)
+        self.assertNotIn(b'chunked', head)
+        self.assertEqual(len(json.loads(body)), 2)
+
+    def test_stream_too_deep(self):
+        c = http.client.HTTPConnection("localhost", 8888)
+        c.request("GET", "/deep/32")
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read()), json.loads('[' * 32 + '32' + ']' * 32))
+        # Invalid JSON is not sent as a complete response
+        c.request("GET", "/deep/33")
+        r = c.getresponse()
+        with self.assertRaises(http.client.IncompleteRead):
+            r.read()
+        c.close()
+
+    def test_pipelining(self):
+        requests = (
+            b"GET /parameter/1 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+            b"POST /upload HTTP/1.1\r\nContent-Length: 5\r\n\r\nsmall"
+            b"POST /req/a/1 HTTP/1.1\r\nContent-Length: 15\r\n\r\n{\"tdata\": \"xx\"}"
+            b"GET /parameter/2 HTTP/1.1\r\n\r\n"
+        )
+        expected = [('result', '1'), ('size', '5'), ('id', '1'), ('result', '2')]
+        with socket.create_connection(("localhost", 8888)) as s:
+            s.settimeout(2)
+            # Every request in a single write
+            s.sendall(requests)
+            f = s.makefile('rb')
+
+            def read_response():
+                status = f.readline()
+                length = 0
+                for line in iter(f.readline, b'\r\n'):
+                    name, _, value = line.partition(b':')
+                    if name.lower() == b'content-length':
+                        length = int(value)
+                return status, f.read(length)
+
+            # Responses come in order on the same connection
+            for key, value in expected:
+                status, body = read_response()
+                self.assertTrue(status.startswith(b'HTTP/1.1 200'))
+                self.assertEqual(json.loads(body)[key], value)
+            # Connection is still usable
+            s.sendall(b"GET /parameter/1 HTTP/1.1\r\n\r\n")
+            status, body = read_response()
+            self.assertEqual(json.loads(body)['result'], '1')
+
+    def test_idle_connections(self):
+        # More idle persistent connections than worker threads
+        start = time.monotonic()
+        idle = []
+        for i in range(20):
+            c = http.client.HTTPConnection("localhost", 8888)
+            c.request("GET", "/")
+            c.getresponse().read()
+            idle.append(c)
+        with re.urlopen(f"{server}/") as f:
+            self.assertEqual(json.loads(f.read())['test'], 'callback')
+        self.assertLess(time.monotonic() - start, 2)
+        for c in idle:
+            c.close()
+
+    def test_body_limit(self):
+        heads = [
+            b"POST /method HTTP/1.1\r\nContent-Length: 1000000\r\n\r\nxxxx",
+            b"POST /method HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n20000\r\nxxxx",
+        ]
+        for head in heads:
+            # Refused without waiting for the rest of the body
+            with socket.create_connection(("localhost", 8888)) as s:
+                s.settimeout(2)
+                s.sendall(head)
+                data = b''
+                while True:
+                    part = s.recv(65536)
+                    if not part:
+                        break
+                    data += part
+            self.assertTrue(data.startswith(b'HTTP/1.1 413'))
+        # Bodies under the limit and streamed bodies are not refused
+        c = http.client.HTTPConnection("localhost", 8888)
+        c.request("POST", "/method", body=b'x' * 60000)
+        r = c.getresponse()
+        self.assertEqual(json.loads(r.read())['method'], 'POST')
+        c.close()
+
 if __name__ == '__main__':
         unittest.main()
@@ -0,0 +1,10 @@
+// Same server as i_simpleapi but the clients are served by one event loop
+#define main simpleapi_main
+#include "i_simpleapi.c"
+#undef main
+
+int main(int argc, char const* argv[])
+{
+    set_server_option_event_loop_threads(1);
+    return simpleapi_main(argc, argv);
+}
@@ -0,0 +1,37 @@
+import http.client
+import json
+import socket
+import time
+import unittest
+import urllib.request as re
+
+# Every test of i_simpleapi is run against the event loop too
+from i_simpleapi import TestSimpleCallback, server
+
+class TestEventLoop(unittest.TestCase):
+
+    def test_slow_reader(self):
+        # Response is much larger than the socket buffers
+        s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+        s.connect(("localhost", 8888))
+        slow = http.client.HTTPConnection("localhost", 8888)
+        slow.sock = s
+        slow.request("GET", "/stream/200000")
+        time.sleep(0.5)
+        # Loop serves other clients while the first one doesn't read
+        start = time.monotonic()
+        with re.urlopen(f"{server}/") as f:
+            self.assertEqual(json.loads(f.read())['test'], 'callback')
+        self.assertLess(time.monotonic() - start, 1)
+        # Whole response is still sent and the connection can be reused
+        r = slow.getresponse()
+        items = json.loads(r.read())
+        self.assertEqual(len(items), 200000)
+        self.assertEqual(items[-1]['i'], 199999)
+        slow.request("GET", "/parameter/2")
+        self.assertEqual(json.loads(slow.getresponse().read())['result'], '2')
+        slow.close()
+
+if __name__ == '__main__':
+        unittest.main()
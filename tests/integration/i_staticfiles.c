@@ -20,6 +20,8 @@ int main(int argc, const char* argv[])
 {
     RestServer rs;
     init_server(&rs);
+    // index.html and style.css are sent from memory, javascript.js with sendfile
+    set_server_option_file_cache_memory(1024);
     add_url(&rs, "/", static_html);
     add_url(&rs, "/css", static_css);
     add_url(&rs, "/javascript", static_js);
@@ -1,4 +1,8 @@
+import gzip
+import http.client
 import json
+import os
+import time
 import unittest
 import urllib.request as re
 
@@ -61,6 +65,113 @@ class TestStaticFiles(unittest.TestCase):
             self.assertNotEqual(data, None)
             self.assertEqual(len(data), 1085)
 
+    def test_not_modified(self):
+        c = http.client.HTTPConnection("localhost", 8888)
+        c.request("GET", "/tests/html/style.css")
+        r = c.getresponse()
+        r.read()
+        etag = r.getheader("ETag")
+        last_modified = r.getheader("Last-Modified")
+        self.assertNotEqual(etag, None)
+        c.request("GET", "/tests/html/style.css", headers={"If-None-Match": etag})
+        r = c.getresponse()
+        self.assertEqual(r.status, 304)
+        self.assertEqual(len(r.read()), 0)
+        # Revalidated caches keep the variants of the 200 apart
+        self.assertEqual(r.getheader("Vary"), "Accept-Encoding")
+        c.request("GET", "/tests/html/style.css", headers={"If-Modified-Since": last_modified})
+        r = c.getresponse()
+        self.assertEqual(r.status, 304)
+        r.read()
+        c.request("GET", "/tests/html/index.html")
+        r = c.getresponse()
+        r.read()
+        c.request("GET", "/tests/html/index.html", headers={"If-None-Match": r.getheader("ETag")})
+        r = c.getresponse()
+        self.assertEqual(r.status, 304)
+        self.assertEqual(r.getheader("Vary"), None)
+        r.read()
+        c.request("GET", "/tests/html/style.css", headers={"If-None-Match": "\"other\""})
+        r = c.getresponse()
+        self.assertEqual(r.status, 200)
+        self.assertEqual(len(r.read()), 179)
+        c.close()
+
+    def test_precompressed(self):
+        req = re.Request(url=f"{server}/tests/html/style.css", headers={"Accept-Encoding": "gzip, deflate"})
+        with re.urlopen(req) as f:
+            header = f.info()
+            self.assertIn("text/css", str(header))
+            self.assertEqual(header["Content-Encoding"], "gzip")
+            self.assertEqual(len(gzip.decompress(f.read())), 179)
+        req = re.Request(url=f"{server}/tests/html/index.html", headers={"Accept-Encoding": "gzip"})
+        with re.urlopen(req) as f:
+            self.assertEqual(f.info()["Content-Encoding"], None)
+            self.assertEqual(f.info()["Vary"], None)
+            self.assertEqual(len(f.read()), 520)
+        # The identity variant of a file with a sibling varies too
+        req = re.Request(url=f"{server}/tests/html/style.css")
+        with re.urlopen(req) as f:
+            self.assertEqual(f.info()["Content-Encoding"], None)
+            self.assertEqual(f.info()["Vary"], "Accept-Encoding")
+            self.assertEqual(len(f.read()), 179)
+
+    def test_missing_files(self):
+        # Misses are cached apart from the open files
+        for i in range(200):
+            with self.assertRaises(re.HTTPError) as e:
+                re.urlopen(f"{server}/tests/html/missing{i}.html")
+            self.assertEqual(e.exception.code, 404)
+        with re.urlopen(f"{server}/tests/html/index.html") as f:
+            self.assertEqual(len(f.read()), 520)
+
+    def test_memory_cache(self):
+        # Rendered once and sent from memory afterwards
+        for i in range(3):
+            c = http.client.HTTPConnection("localhost", 8888)
+            c.request("GET", "/tests/html/index.html")
+            r = c.getresponse()
+            self.assertEqual(r.status, 200)
+            self.assertIn("text/html", r.getheader("Content-Type"))
+            self.assertEqual(r.getheader("Content-Length"), "520")
+            self.assertNotEqual(r.getheader("ETag"), None)
+            data = r.read()
+            self.assertEqual(len(data), 520)
+            with open("tests/html/index.html", "rb") as f:
+                self.assertEqual(data, f.read())
+            c.close()
+        # Variants are rendered with their own headers
+        c = http.client.HTTPConnection("localhost", 8888)
+        c.request("GET", "/tests/html/style.css", headers={"Accept-Encoding": "gzip"})
+        r = c.getresponse()
+        self.assertEqual(r.getheader("Content-Encoding"), "gzip")
+        self.assertEqual(len(gzip.decompress(r.read())), 179)
+        c.request("GET", "/tests/html/style.css")
+        r = c.getresponse()
+        self.assertEqual(r.getheader("Content-Encoding"), None)
+        self.assertEqual(r.getheader("Vary"), "Accept-Encoding")
+        self.assertEqual(len(r.read()), 179)
+        c.close()
+
+    def test_memory_cache_changed_file(self):
+        path = "tests/html/changing.html"
+        try:
+            with open(path, "w") as f:
+                f.write("first")
+            with re.urlopen(f"{server}/{path}") as f:
+                self.assertEqual(f.read(), b"first")
+                etag = f.info()["ETag"]
+            with open(path, "w") as f:
+                f.write("second version")
+            # Picked up once the file is compared to the file system again
+            time.sleep(1.5)
+            with re.urlopen(f"{server}/{path}") as f:
+                self.assertEqual(f.info()["Content-Length"], "14")
+                self.assertNotEqual(f.info()["ETag"], etag)
+                self.assertEqual(f.read(), b"second version")
+        finally:
+            os.remove(path)
+
 
 if __name__ == '__main__':
     unittest.main()